@@ -0,0 +1,413 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Implementation of Checkpointer class
+*
+* @details
+* The inputs are counted a chunk at a time (see ChunkReader), so the number
+* of bytes counted in the current input always ends at white space and is a
+* place the count can pick up from. Every so often the counts are saved with
+* that place as a snapshot: a header followed by the counter's image, whose
+* links are all indexes and offsets (see WordTable::saveImage).
+*
+* A snapshot is written to a file next to the real one, flushed to disk and
+* renamed over the real one, and the directory is flushed too, so after a
+* crash the file holds either the last snapshot or the one before, never
+* part of one. Loading maps the file, checks the image against the checksum
+* saved with it and copies its arrays back whole: nothing is parsed, hashed
+* or linked word by word, so a restart costs about as long as reading the
+* file twice. The links in the image are not checked one by one; the
+* checksum is what keeps a damaged snapshot from being loaded. A plain input
+* is then positioned at the saved byte without being read; a compressed one
+* has its counted part decompressed and thrown away.
+*
+* A snapshot holds a fingerprint of the input names, their sizes, inodes and
+* modification times and the settings the counts depend on, and is only used
+* by a run that matches it.
+*
+******************************************************************************/
+#include "checkpoint.h"
+#include "dedup.h"
+#include "inputfile.h"
+
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+
+/*!
+ * @brief First bytes of a snapshot file
+ */
+static const char SNAPSHOT_MAGIC[8] = { 'W', 'F', 'S', 'N', 'A', 'P', '1', 0 };
+
+/*!
+ * @brief Stored in a snapshot to tell its byte order
+ */
+static const uint64_t SNAPSHOT_ORDER = 0x0102030405060708ull;
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates a checkpointer that keeps its snapshot in path.
+ *
+ * @param[in] path - the snapshot file
+ * @param[in] seconds - time between snapshots, 0 for none
+ *
+ ******************************************************************************/
+Checkpointer::Checkpointer ( const string &path, unsigned seconds )
+{
+    this->path = path;
+    this->seconds = seconds;
+    totals = checkpointStats();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function sets a description of the options the counts depend on,
+ * such as the stop words. It becomes part of the fingerprint, so a snapshot
+ * made with other settings is not used.
+ *
+ * @param[in] settings - the options, in any form
+ *
+ ******************************************************************************/
+void Checkpointer::setSettings ( string_view settings )
+{
+    this->settings = settings;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function counts the files into result, which should be empty and
+ * leave out the same stop words as the run that made any snapshot. If a
+ * snapshot of the same inputs and settings exists, the counts are loaded
+ * from it and counting picks up where it was saved. A snapshot is saved
+ * each time the set number of seconds has passed; one that cannot be
+ * written is skipped and counting goes on.
+ *
+ * @param[in]     paths - the files, in order
+ * @param[in,out] result - where the words are counted
+ *
+ * @returns true - every file was counted
+ * @returns false - a file is corrupt, or shorter than the snapshot says
+ *
+ ******************************************************************************/
+bool Checkpointer::count ( const vector<string> &paths, WordCounter &result )
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::time_point due;
+    span<const char> chunk;
+    uint64_t print = fingerprint ( paths );
+    uint64_t input = 0;     //Input being counted
+    uint64_t offset = 0;    //Bytes of it counted
+    bool ok = true;
+
+    totals = checkpointStats();
+
+    if ( restore ( result, print, paths.size(), input, offset ) )
+    {
+        totals.resumed = true;
+        totals.input = input;
+        totals.offset = offset;
+        totals.restoreSeconds = chrono::duration<double> (
+                                    chrono::steady_clock::now() - start ).count();
+    }
+    else
+    {
+        input = 0;
+        offset = 0;
+    }
+
+    due = chrono::steady_clock::now() + chrono::seconds ( seconds );
+
+    for ( ; input < paths.size() && ok; input++ )
+    {
+        InputFile fin;
+        ChunkReader reader ( fin );
+
+        fin.open ( paths[input].c_str() );
+
+        //Pass over what the snapshot already counted
+        if ( offset != 0 && !fin.skip ( offset ) )
+        {
+            return false;
+        }
+
+        while ( reader.next ( chunk ) )
+        {
+            result.ingest ( chunk );
+            offset += chunk.size();
+
+            if ( seconds != 0 && chrono::steady_clock::now() >= due )
+            {
+                save ( result, print, input, offset );
+                due = chrono::steady_clock::now() + chrono::seconds ( seconds );
+            }
+        }
+
+        ok = !fin.bad();
+        offset = 0;
+    }
+
+    return ok;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function removes the snapshot, once whatever the counts were for is
+ * done with them.
+ *
+ * @returns true - there is no snapshot left
+ * @returns false - the snapshot could not be removed
+ *
+ ******************************************************************************/
+bool Checkpointer::finish()
+{
+    return unlink ( path.c_str() ) == 0 || errno == ENOENT;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns what checkpointing did during the last count.
+ *
+ * @returns the figures
+ *
+ ******************************************************************************/
+checkpointStats Checkpointer::stats()
+{
+    return totals;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function fingerprints the settings and the inputs, by name, size,
+ * inode and modification time, with 64 bit FNV-1a. An input rewritten in
+ * place to the same size still changes the fingerprint.
+ *
+ * @param[in] paths - the files, in order
+ *
+ * @returns the fingerprint
+ *
+ ******************************************************************************/
+uint64_t Checkpointer::fingerprint ( const vector<string> &paths )
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    struct stat info;
+    uint64_t facts[5];      //Size, device, inode, modification time
+    auto add = [&hash] ( const void *data, size_t length )
+    {
+        const unsigned char *bytes = ( const unsigned char * ) data;
+
+        for ( size_t i = 0; i < length; i++ )
+        {
+            hash = ( hash ^ bytes[i] ) * 0x100000001b3ull;
+        }
+    };
+
+    add ( settings.c_str(), settings.length() + 1 );
+
+    for ( const string &name : paths )
+    {
+        if ( stat ( name.c_str(), &info ) != 0 )
+        {
+            info = {};
+        }
+
+        facts[0] = ( uint64_t ) info.st_size;
+        facts[1] = ( uint64_t ) info.st_dev;
+        facts[2] = ( uint64_t ) info.st_ino;
+        facts[3] = ( uint64_t ) info.st_mtim.tv_sec;
+        facts[4] = ( uint64_t ) info.st_mtim.tv_nsec;
+        add ( name.c_str(), name.length() + 1 );
+        add ( facts, sizeof ( facts ) );
+    }
+
+    return hash;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function loads the snapshot, if there is one made from the same
+ * inputs and settings by this build and its image matches its checksum.
+ *
+ * @param[in,out] result - where the counts are loaded
+ * @param[in]     print - fingerprint of this run
+ * @param[in]     inputs - number of inputs in this run
+ * @param[out]    input - input to resume in
+ * @param[out]    offset - bytes of it already counted
+ *
+ * @returns true - the counts were loaded
+ * @returns false - there is no snapshot that fits, or it is damaged;
+ * result is unchanged
+ *
+ ******************************************************************************/
+bool Checkpointer::restore ( WordCounter &result, uint64_t print,
+                             size_t inputs, uint64_t &input, uint64_t &offset )
+{
+    snapshotHeader header;
+    struct stat info;
+    char *image;
+    size_t size;
+    bool ok;
+    int fd = open ( path.c_str(), O_RDONLY );
+
+    if ( fd < 0 )
+    {
+        return false;
+    }
+
+    if ( fstat ( fd, &info ) != 0 || info.st_size < ( off_t ) sizeof ( header ) )
+    {
+        close ( fd );
+        return false;
+    }
+
+    size = ( size_t ) info.st_size;
+    image = ( char * ) mmap ( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close ( fd );
+
+    if ( image == MAP_FAILED )
+    {
+        return false;
+    }
+
+    madvise ( image, size, MADV_SEQUENTIAL );
+    memcpy ( &header, image, sizeof ( header ) );
+
+    ok = memcmp ( header.magic, SNAPSHOT_MAGIC, sizeof ( header.magic ) ) == 0 &&
+         header.order == SNAPSHOT_ORDER && header.print == print &&
+         header.size == size && header.input < inputs &&
+         header.sum == hashWord ( image + sizeof ( header ),
+                                  size - sizeof ( header ) ) &&
+         result.loadImage ( image + sizeof ( header ), size - sizeof ( header ) );
+
+    munmap ( image, size );
+
+    input = header.input;
+    offset = header.offset;
+
+    return ok;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function saves the counts and how far they got as the snapshot. The
+ * snapshot is written through a mapping of a new file beside the old one,
+ * checksummed, flushed, and renamed over the old one; the directory is flushed so the
+ * rename survives a crash as well. The file's space is reserved before it is
+ * mapped, so a full disk skips the snapshot instead of faulting on a store
+ * into the mapping.
+ *
+ * @param[in] counts - the counts so far
+ * @param[in] print - fingerprint of this run
+ * @param[in] input - input being counted
+ * @param[in] offset - bytes of it counted
+ *
+ * @returns true - the snapshot was saved
+ * @returns false - it could not be written; the old snapshot is kept
+ *
+ ******************************************************************************/
+bool Checkpointer::save ( WordCounter &counts, uint64_t print, uint64_t input,
+                          uint64_t offset )
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    string temp = path + ".tmp";
+    filesystem::path folder = filesystem::path ( path ).parent_path();
+    snapshotHeader header = {};
+    size_t size = sizeof ( header ) + counts.imageSize();
+    char *image = ( char * ) MAP_FAILED;
+    bool ok;
+    int fd = open ( temp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+
+    memcpy ( header.magic, SNAPSHOT_MAGIC, sizeof ( header.magic ) );
+    header.order = SNAPSHOT_ORDER;
+    header.print = print;
+    header.input = input;
+    header.offset = offset;
+    header.size = size;
+
+    //Reserve the blocks, a sparse file could run out of space mid store
+    ok = fd >= 0 && posix_fallocate ( fd, 0, ( off_t ) size ) == 0;
+
+    if ( ok )
+    {
+        image = ( char * ) mmap ( nullptr, size, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, fd, 0 );
+        ok = image != MAP_FAILED;
+    }
+
+    if ( ok )
+    {
+        counts.saveImage ( image + sizeof ( header ) );
+        header.sum = hashWord ( image + sizeof ( header ),
+                                size - sizeof ( header ) );
+        memcpy ( image, &header, sizeof ( header ) );
+        ok = msync ( image, size, MS_SYNC ) == 0;
+        munmap ( image, size );
+    }
+
+    ok = ok && fsync ( fd ) == 0;
+
+    if ( fd >= 0 )
+    {
+        close ( fd );
+    }
+
+    if ( !ok || rename ( temp.c_str(), path.c_str() ) != 0 )
+    {
+        unlink ( temp.c_str() );
+        totals.failed++;
+        return false;
+    }
+
+    fd = open ( folder.empty() ? "." : folder.c_str(), O_RDONLY | O_DIRECTORY );
+
+    if ( fd >= 0 )
+    {
+        fsync ( fd );
+        close ( fd );
+    }
+
+    totals.snapshots++;
+    totals.saveSeconds += chrono::duration<double> (
+                              chrono::steady_clock::now() - start ).count();
+
+    return true;
+}
@@ -0,0 +1,81 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Definition of Checkpointer class
+*
+******************************************************************************/
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "wordcounter.h"
+
+using namespace std;
+
+#ifndef __CHECKPOINT_H
+#define __CHECKPOINT_H
+
+/*!
+ * @brief What checkpointing did during a count
+ */
+struct checkpointStats
+{
+    bool resumed;               /*!< If the count picked up from a snapshot */
+    uint64_t input;             /*!< Input the count resumed in */
+    uint64_t offset;            /*!< Bytes of that input already counted */
+    uint64_t snapshots;         /*!< Snapshots written */
+    uint64_t failed;            /*!< Snapshots that could not be written */
+    double restoreSeconds;      /*!< Time spent loading the snapshot */
+    double saveSeconds;         /*!< Time spent writing snapshots */
+};
+
+
+
+/*!
+ * @brief counts files into a WordCounter, saving a snapshot of the counts
+ * and how far it got every so often, and picks up from the snapshot when
+ * run again after a crash
+ */
+class Checkpointer
+{
+    public:
+        Checkpointer ( const string &path, unsigned seconds );
+
+        void setSettings ( string_view settings );
+        bool count ( const vector<string> &paths, WordCounter &result );
+        bool finish();
+        checkpointStats stats();
+
+    private:
+        /*!
+        * @brief Start of a snapshot file, padded to a cache line; the image
+        * of the counts follows it
+        */
+        struct snapshotHeader
+        {
+            char magic[8];      /*!< Identifies a snapshot file */
+            uint64_t order;     /*!< A known number, for the byte order */
+            uint64_t print;     /*!< Fingerprint of the inputs and settings */
+            uint64_t input;     /*!< Input to resume in */
+            uint64_t offset;    /*!< Bytes of that input already counted */
+            uint64_t size;      /*!< Bytes in the snapshot */
+            uint64_t sum;       /*!< Checksum of the image */
+            uint64_t reserved;  /*!< Zero */
+        };
+
+        uint64_t fingerprint ( const vector<string> &paths );
+        bool restore ( WordCounter &result, uint64_t print, size_t inputs,
+                       uint64_t &input, uint64_t &offset );
+        bool save ( WordCounter &counts, uint64_t print, uint64_t input,
+                    uint64_t offset );
+
+        string path;            /*!< Where the snapshot is kept */
+        unsigned seconds;       /*!< Time between snapshots */
+        string settings;        /*!< Options the counts depend on */
+        checkpointStats totals; /*!< Figures for the last count */
+};
+
+#endif
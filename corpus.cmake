@@ -0,0 +1,51 @@
+#
+# Builds the training and benchmark corpus out of BandB.txt.
+#
+#   cmake -DINPUT=BandB.txt -DOUTPUT=corpus.txt -DCOPIES=400 -P corpus.cmake
+#
+# A story repeated as is would only ever count the same few hundred words.
+# To give the tables a long tail the way real text does, every copy gives
+# its words of seven letters or more a suffix of its own (copy 1 adds "b",
+# copy 27 "bb" and so on), and every fourth copy is in capitals so case
+# folding is exercised. The short, common words keep their counts growing,
+# and the long ones add a few hundred new words per copy. The output is the
+# same on every run.
+#
+if ( NOT INPUT OR NOT OUTPUT )
+    message ( FATAL_ERROR "INPUT and OUTPUT must name the story and corpus" )
+endif ()
+
+if ( NOT COPIES )
+    set ( COPIES 400 )
+endif ()
+
+file ( READ ${INPUT} story )
+string ( REPLACE "\r\n" "\n" story "${story}" )
+set ( letters "abcdefghijklmnopqrstuvwxyz" )
+set ( corpus "" )
+
+foreach ( copy RANGE 1 ${COPIES} )
+    #Spell the copy number in letters
+    set ( suffix "" )
+    set ( number ${copy} )
+
+    while ( number GREATER 0 )
+        math ( EXPR digit "${number} % 26" )
+        math ( EXPR number "${number} / 26" )
+        string ( SUBSTRING ${letters} ${digit} 1 letter )
+        string ( PREPEND suffix ${letter} )
+    endwhile ()
+
+    string ( REGEX REPLACE "([A-Za-z][a-z][a-z][a-z][a-z][a-z][a-z]+)"
+             "\\1${suffix}" text "${story}" )
+
+    math ( EXPR shout "${copy} % 4" )
+
+    if ( shout EQUAL 0 )
+        string ( TOUPPER "${text}" text )
+    endif ()
+
+    string ( APPEND corpus "${text}\n" )
+endforeach ()
+
+file ( WRITE ${OUTPUT} "${corpus}" )
@@ -0,0 +1,558 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Implementation of DedupCounter class
+*
+* @details
+* Every document is read twice. The pre-pass cuts it into chunks of about
+* 64 KiB, each ending at white space, and fingerprints each chunk (chunk
+* mode) or the whole document (file mode) with two independent 64 bit
+* hashes and the length, noting how often each fingerprint occurs. The
+* counting pass cuts the documents into the same chunks again. Content that
+* occurs once is counted straight into the result. Repeated content is
+* counted once into a table of its own, added to the result multiplied by
+* the number of times it occurs, and skipped everywhere else; in file mode
+* a repeated document is skipped without reading it again.
+*
+* Chunks are cut at fixed sizes, not by content, so two documents share
+* chunks only up to the first place they differ: identical files, mirrors
+* and copies that were appended to all line up, but text shifted by an
+* insertion near the start does not.
+*
+* A document can grow between the two passes, as a live log does. A chunk
+* that is not the length the pre-pass found, or that is past the ones it
+* found, is counted in full, so text appended in between is counted rather
+* than lost.
+*
+******************************************************************************/
+#include "dedup.h"
+#include "inputfile.h"
+#include "tokenizer.h"
+
+#include <chrono>
+#include <cstring>
+
+
+
+/*!
+ * @brief Size a chunk is read at before it is cut back to white space
+ */
+static const size_t CHUNK_SIZE = 1 << 16;
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates a reader for a stream.
+ *
+ * @param[in,out] in - the stream to read
+ *
+ ******************************************************************************/
+ChunkReader::ChunkReader ( istream &in ) : in ( in )
+{
+    buffer.resize ( CHUNK_SIZE );
+    carry = 0;
+    cut = 0;
+    filled = 0;
+    ended = false;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads the next chunk. The word cut off at the end of the
+ * buffer is carried to the front of the next chunk; a word that fills the
+ * whole buffer makes the buffer grow.
+ *
+ * @param[out] chunk - the chunk, valid until the next call
+ *
+ * @returns true - a chunk was read
+ * @returns false - the stream is used up or went bad
+ *
+ ******************************************************************************/
+bool ChunkReader::next ( span<const char> &chunk )
+{
+    if ( ended )
+    {
+        return false;
+    }
+
+    memmove ( buffer.data(), buffer.data() + cut, carry );
+
+    while ( true )
+    {
+        if ( carry == buffer.size() )
+        {
+            buffer.resize ( buffer.size() * 2 );
+        }
+
+        in.read ( buffer.data() + carry, buffer.size() - carry );
+        filled = carry + ( size_t ) in.gcount();
+
+        //Last chunk, whatever is left
+        if ( !in )
+        {
+            ended = true;
+            chunk = span<const char> ( buffer.data(), filled );
+            return filled > 0 && !in.bad();
+        }
+
+        //Back up to the white space before the last word
+        cut = filled;
+
+        while ( cut > 0 && !isSeparator ( buffer[cut - 1] ) )
+        {
+            cut--;
+        }
+
+        if ( cut > 0 )
+        {
+            chunk = span<const char> ( buffer.data(), cut );
+            carry = filled - cut;
+            return true;
+        }
+
+        carry = filled;
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates a counter that fingerprints whole documents or
+ * chunks.
+ *
+ * @param[in] mode - what to fingerprint
+ *
+ ******************************************************************************/
+DedupCounter::DedupCounter ( dedupMode mode )
+{
+    this->mode = mode;
+    stop = nullptr;
+    totals = dedupStats();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function sets the words to leave out of the counts. The result passed
+ * to count should leave out the same words.
+ *
+ * @param[in] stop - the stop words, nullptr to count everything
+ *
+ ******************************************************************************/
+void DedupCounter::setStopWords ( StopWords *stop )
+{
+    this->stop = stop;
+    table.setStopWords ( stop );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function makes repeated content count the variants of words too, so
+ * they are multiplied into the result like the words. The result should
+ * count variants as well.
+ *
+ * @param[in] track - true to count the variants
+ *
+ ******************************************************************************/
+void DedupCounter::setVariants ( bool track )
+{
+    table.setVariants ( track );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function counts a set of documents into result, with the same counts
+ * as counting every one of them in full. The pre-pass finds the repeats,
+ * then each distinct document or chunk is counted once.
+ *
+ * @param[in]     paths - the documents, may be gzip or zstd
+ * @param[in,out] result - where the counts are added
+ *
+ * @returns true - every document was read and counted
+ * @returns false - a document did not open or could not be decompressed
+ *
+ ******************************************************************************/
+bool DedupCounter::count ( const vector<string> &paths, WordCounter &result )
+{
+    vector<vector<fingerprint>> prints;     //Fingerprints of each document
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    span<const char> chunk;
+    size_t index = 0;
+    uint64_t counted = 0;   //Chunks of the document counted
+    bool ok = true;
+
+    seen.clear();
+    totals = dedupStats();
+
+    if ( !prepass ( paths, prints ) )
+    {
+        return false;
+    }
+
+    totals.prepassSeconds = chrono::duration<double> (
+                                chrono::steady_clock::now() - start ).count();
+    start = chrono::steady_clock::now();
+
+    for ( size_t doc = 0; doc < paths.size() && ok; doc++ )
+    {
+        occurrence *whole = nullptr;
+
+        //A repeated document is counted the first time only
+        if ( mode == FILE_DEDUP )
+        {
+            whole = &seen[prints[doc][0]];
+
+            if ( whole->counted )
+            {
+                totals.documentsSkipped++;
+                totals.chunksSkipped += prints[doc].size() - 1;
+                totals.bytesSkipped += prints[doc][0].length;
+                continue;
+            }
+
+            table.clear();
+        }
+
+        InputFile fin;
+        ChunkReader reader ( fin );
+
+        fin.open ( paths[doc].c_str() );
+        index = 0;
+        counted = 0;
+
+        if ( !fin )
+        {
+            ok = false;
+            continue;
+        }
+
+        while ( reader.next ( chunk ) )
+        {
+            if ( mode == CHUNK_DEDUP && ( index >= prints[doc].size() ||
+                                          chunk.size() !=
+                                          prints[doc][index].length ) )
+            {
+                //The document grew after the pre-pass read it
+                countChunk ( chunk, 1, result );
+                counted++;
+
+                if ( index < prints[doc].size() )
+                {
+                    totals.bytes -= prints[doc][index].length;
+                    seen[prints[doc][index]].times--;
+                }
+                else
+                {
+                    totals.chunks++;
+                }
+
+                totals.bytes += chunk.size();
+            }
+            else if ( mode == FILE_DEDUP )
+            {
+                //Once into its own table if it repeats
+                countChunk ( chunk, 1, whole->times > 1 ? table : result );
+                counted++;
+            }
+            else
+            {
+                occurrence &part = seen[prints[doc][index]];
+
+                if ( part.counted )
+                {
+                    totals.chunksSkipped++;
+                    totals.bytesSkipped += chunk.size();
+                }
+                else
+                {
+                    countChunk ( chunk, part.times, result );
+                    part.counted = true;
+                    counted++;
+                }
+            }
+
+            index++;
+        }
+
+        ok = !fin.bad();
+
+        if ( mode == FILE_DEDUP )
+        {
+            if ( whole->times > 1 )
+            {
+                result.merge ( table, whole->times );
+            }
+
+            whole->counted = true;
+        }
+        else if ( counted == 0 && index > 0 )
+        {
+            totals.documentsSkipped++;
+        }
+    }
+
+    totals.countSeconds = chrono::duration<double> (
+                              chrono::steady_clock::now() - start ).count();
+
+    //Skipped text would have been counted at the same speed
+    if ( totals.bytes > totals.bytesSkipped )
+    {
+        totals.savedSeconds = totals.countSeconds * totals.bytesSkipped /
+                              ( totals.bytes - totals.bytesSkipped );
+    }
+
+    return ok;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns what the last count found and saved.
+ *
+ * @returns the figures
+ *
+ ******************************************************************************/
+dedupStats DedupCounter::stats()
+{
+    return totals;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads every document once, fingerprinting each chunk or
+ * each whole document and counting how many times each fingerprint occurs.
+ *
+ * @param[in]  paths - the documents
+ * @param[out] prints - for each document, its chunks' fingerprints, preceded
+ * in file mode by the fingerprint of the whole document
+ *
+ * @returns true - every document was read
+ * @returns false - a document did not open or could not be decompressed
+ *
+ ******************************************************************************/
+bool DedupCounter::prepass ( const vector<string> &paths,
+                             vector<vector<fingerprint>> &prints )
+{
+    span<const char> chunk;
+    fingerprint print;
+
+    prints.assign ( paths.size(), {} );
+
+    for ( size_t doc = 0; doc < paths.size(); doc++ )
+    {
+        InputFile fin;
+        ChunkReader reader ( fin );
+        fingerprint whole = { 0, 0, 0 };
+
+        fin.open ( paths[doc].c_str() );
+
+        if ( !fin )
+        {
+            return false;
+        }
+
+        if ( mode == FILE_DEDUP )
+        {
+            prints[doc].push_back ( whole );
+        }
+
+        while ( reader.next ( chunk ) )
+        {
+            print = { 0, 0, 0 };
+            addText ( chunk, mode == FILE_DEDUP ? whole : print );
+
+            prints[doc].push_back ( print );
+
+            if ( mode == CHUNK_DEDUP )
+            {
+                seen[print].times++;
+            }
+
+            totals.chunks++;
+            totals.bytes += chunk.size();
+        }
+
+        if ( fin.bad() )
+        {
+            return false;
+        }
+
+        if ( mode == FILE_DEDUP )
+        {
+            prints[doc][0] = whole;
+            seen[whole].times++;
+        }
+
+        totals.documents++;
+    }
+
+    return true;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function adds text to a fingerprint. Both hashes take the text 8
+ * bytes at a time, with different multipliers and shifts, so a collision in
+ * one is no help with the other.
+ *
+ * @param[in]     text - the text
+ * @param[in,out] print - the fingerprint
+ *
+ ******************************************************************************/
+void DedupCounter::addText ( span<const char> text, fingerprint &print )
+{
+    const char *pos = text.data();
+    size_t left = text.size();
+    uint64_t block = 0;
+    uint64_t low = print.low ^ 0x9e3779b97f4a7c15ull;
+    uint64_t high = print.high ^ 0x2545f4914f6cdd1dull;
+
+    while ( left > 0 )
+    {
+        block = 0;
+        memcpy ( &block, pos, left < 8 ? left : 8 );
+        pos += left < 8 ? left : 8;
+        left -= left < 8 ? left : 8;
+
+        low = ( low ^ block ) * 0xff51afd7ed558ccdull;
+        low ^= low >> 32;
+        high = ( high ^ block ) * 0xc4ceb9fe1a85ec53ull;
+        high ^= high >> 29;
+    }
+
+    print.low = low ^ text.size();
+    print.high = high + text.size();
+    print.length += text.size();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function counts a chunk of text into result as many times as it
+ * occurs. Text that occurs once is counted in place; repeated text is
+ * counted into the scratch table and merged in multiplied.
+ *
+ * @param[in]     text - the chunk
+ * @param[in]     times - number of times the chunk occurs
+ * @param[in,out] result - where the counts are added
+ *
+ ******************************************************************************/
+void DedupCounter::countChunk ( span<const char> text, uint64_t times,
+                                WordCounter &result )
+{
+    if ( times == 1 )
+    {
+        result.ingest ( text );
+        return;
+    }
+
+    table.clear();
+    table.ingest ( text );
+    result.merge ( table, times );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function compares two fingerprints.
+ *
+ * @param[in] other - the other fingerprint
+ *
+ * @returns true if both hashes and the length match
+ *
+ ******************************************************************************/
+bool DedupCounter::fingerprint::operator== ( const fingerprint &other ) const
+{
+    return low == other.low && high == other.high && length == other.length;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function picks the hash an unordered_map uses for a fingerprint.
+ *
+ * @param[in] print - the fingerprint
+ *
+ * @returns the first hash, already well mixed
+ *
+ ******************************************************************************/
+size_t DedupCounter::fingerprintHash::operator() ( const fingerprint &print )
+const
+{
+    return ( size_t ) print.low;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function looks up a deduplication mode by the name used on the
+ * command line: file or chunk.
+ *
+ * @param[in]  name - the mode's name
+ * @param[out] mode - the mode, unchanged if the name is unknown
+ *
+ * @returns true - the name is a mode
+ * @returns false - there is no mode with that name
+ *
+ ******************************************************************************/
+bool parseDedup ( string_view name, dedupMode &mode )
+{
+    if ( name == "file" )
+    {
+        mode = FILE_DEDUP;
+    }
+    else if ( name == "chunk" )
+    {
+        mode = CHUNK_DEDUP;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
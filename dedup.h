@@ -0,0 +1,144 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Definition of DedupCounter class
+*
+******************************************************************************/
+
+#include <istream>
+#include <string>
+#include <vector>
+#include <span>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#include "wordcounter.h"
+#include "stopwords.h"
+
+using namespace std;
+
+#ifndef __DEDUP_H
+#define __DEDUP_H
+
+/*!
+ * @brief What is fingerprinted to find repeated content
+ */
+enum dedupMode
+{
+    NO_DEDUP,           /*!< Count every document in full */
+    FILE_DEDUP,         /*!< Whole documents */
+    CHUNK_DEDUP         /*!< Fixed size chunks of each document */
+};
+
+
+
+/*!
+ * @brief What deduplication found and what it was worth
+ */
+struct dedupStats
+{
+    uint64_t documents;         /*!< Documents read */
+    uint64_t documentsSkipped;  /*!< Documents with nothing left to count */
+    uint64_t chunks;            /*!< Chunks read */
+    uint64_t chunksSkipped;     /*!< Chunks not counted again */
+    uint64_t bytes;             /*!< Bytes of text read */
+    uint64_t bytesSkipped;      /*!< Bytes of text not counted again */
+    double prepassSeconds;      /*!< Time spent fingerprinting */
+    double countSeconds;        /*!< Time spent counting the rest */
+    double savedSeconds;        /*!< Estimated counting time skipped */
+};
+
+
+
+/*!
+ * @brief Reads a stream in chunks of about the same size, each cut at white
+ * space, so the same text always cuts into the same chunks
+ */
+class ChunkReader
+{
+    public:
+        ChunkReader ( istream &in );
+
+        bool next ( span<const char> &chunk );
+
+    private:
+        istream &in;            /*!< The stream */
+        vector<char> buffer;    /*!< The chunk and the word after it */
+        size_t carry;           /*!< Characters carried to the next chunk */
+        size_t cut;             /*!< End of the last chunk in buffer */
+        size_t filled;          /*!< Characters in buffer */
+        bool ended;             /*!< If the stream is used up */
+};
+
+
+
+/*!
+ * @brief counts a set of documents, counting repeated content only once. A
+ * pre-pass fingerprints every document or chunk; each distinct one is then
+ * counted once into a table of its own and added to the result as many
+ * times as it occurs
+ */
+class DedupCounter
+{
+    public:
+        DedupCounter ( dedupMode mode );
+
+        void setStopWords ( StopWords *stop );
+        void setVariants ( bool track );
+        bool count ( const vector<string> &paths, WordCounter &result );
+        dedupStats stats();
+
+    private:
+        /*!
+        * @brief Fingerprint of some text: two independent 64 bit hashes
+        * and the length
+        */
+        struct fingerprint
+        {
+            uint64_t low;       /*!< First hash */
+            uint64_t high;      /*!< Second hash */
+            uint64_t length;    /*!< Number of bytes */
+
+            bool operator== ( const fingerprint &other ) const;
+        };
+
+        /*!
+        * @brief Hash functor so fingerprints can key an unordered_map
+        */
+        struct fingerprintHash
+        {
+            size_t operator() ( const fingerprint &print ) const;
+        };
+
+        /*!
+        * @brief What is known about one distinct piece of content
+        */
+        struct occurrence
+        {
+            uint64_t times;     /*!< Number of times it occurs */
+            bool counted;       /*!< If it has been added to the result */
+        };
+
+        bool prepass ( const vector<string> &paths,
+                       vector<vector<fingerprint>> &prints );
+        void addText ( span<const char> text, fingerprint &print );
+        void countChunk ( span<const char> text, uint64_t times,
+                          WordCounter &result );
+
+        dedupMode mode;         /*!< What is fingerprinted */
+        StopWords *stop;        /*!< Words to leave out, may be nullptr */
+        unordered_map<fingerprint, occurrence, fingerprintHash> seen;
+        /*!< Every distinct document or chunk */
+        dedupStats totals;      /*!< Figures for the last count */
+        WordCounter table;      /*!< Counts of one repeated piece of text */
+};
+
+
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+bool parseDedup ( string_view name, dedupMode &mode );
+
+#endif
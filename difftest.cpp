@@ -0,0 +1,868 @@
+/**************************************************************************//**
+ * @file
+ * @brief Entry point for the differential test of the counting backends
+ *
+ * @details
+ * The differential test writes a set of generated inputs, runs every
+ * counting backend on each of them and checks that they all write the very
+ * same report with the same exit code. The reports are compared in the tsv
+ * format: prog2 and prog2stl have always padded the columns of their
+ * default report differently, but a word or a count that differs shows up
+ * in any format. The original list counting in prog2 is the reference; the
+ * other backends are the STL list in prog2stl, the hash table, the hash
+ * table with 32 byte AVX2 keys (prog2_wide) and the hash table counting and
+ * writing with several threads.
+ *
+ * The inputs are made to find where the backends could part ways:
+ * - random: skewed random words with punctuation around and inside them,
+ *   mixed case, digits, bytes above 127, NUL bytes and every kind of white
+ *   space
+ * - punctuation: tokens made mostly or only of punctuation, some with a
+ *   single letter left in them
+ * - edges: short tokens that trimming treats specially, one per line
+ * - huge: words of 64 KiB and 4 MiB give or take a byte, longer than the
+ *   read buffers and the parallel counting blocks
+ * - empty and blank: no words at all
+ * - midsize: tens of thousands of different words, so the hash backends
+ *   are checked against the list on a large vocabulary too
+ * - distinct: millions of different words, for the hash backends only
+ *
+ * Every input is generated from a fixed seed, so a failure can be rerun.
+ * Last, every backend writes a few words that are not valid UTF-8 in the
+ * ndjson format, which must escape them so each line is still valid JSON.
+ * The list and the STL list search their lists one word at a time; they
+ * skip the distinct input, which would take them hours.
+ *
+ * For every run the throughput is displayed and, if asked, saved.
+ *
+ * @par Usage:
+ @verbatim
+ difftest [--programs=DIR] [--work=DIR] [--size=N] [--midsize=N]
+          [--distinct=N] [--save=FILE] [--keep]
+ --programs - where prog2, prog2stl and prog2_wide are (next to difftest)
+ --work - where inputs and reports are written (difftest.work)
+ --size - bytes of random and punctuation input (1048576)
+ --midsize - words in the midsize input (20000)
+ --distinct - words in the distinct input (2000000)
+ --save - write the throughput of every run to FILE as tab separated values
+ --keep - keep the inputs and reports
+ @endverbatim
+ *
+ *****************************************************************************/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+
+#include <spawn.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+extern char **environ;
+
+
+
+/*!
+ * @brief One way of counting: a program and the options that select it
+ */
+struct backend
+{
+    string name;            /*!< Name shown in the results */
+    string program;         /*!< Program run */
+    vector<string> args;    /*!< Options given before the files */
+    bool linear;            /*!< If it searches its words one by one */
+    bool available;         /*!< If it can run on this host */
+};
+
+
+
+/*!
+ * @brief One generated input
+ */
+struct testInput
+{
+    string name;            /*!< Name shown in the results */
+    string path;            /*!< Where it was written */
+    uint64_t bytes;         /*!< Its size */
+    bool manyWords;         /*!< If it is too big for the linear backends */
+};
+
+
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+void writeRandom ( const string &path, uint64_t bytes, unsigned seed );
+void writePunctuation ( const string &path, uint64_t bytes, unsigned seed );
+void writeEdges ( const string &path );
+void writeHuge ( const string &path, unsigned seed );
+void writeDistinct ( const string &path, uint64_t words, unsigned seed );
+string makeWord ( mt19937_64 &random, size_t length );
+int runProgram ( const string &program, const vector<string> &args,
+                 double &seconds );
+bool readFile ( const string &path, string &contents );
+size_t firstDifference ( const string &a, const string &b );
+bool checkNdjson ( const vector<backend> &backends, const string &work,
+                   bool keep );
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This is the starting point for the differential test. The arguments are
+ * read and the inputs generated. Each backend then counts each input and
+ * its report is compared with the reference report for that input, the
+ * first backend to count it. The results are displayed as they come.
+ *
+ * @param[in] argc - count of arguments in argv
+ * @param[in] argv - array of arguments read from the command line
+ *
+ * @return 0 - every backend wrote the same reports
+ * @return 1 - a report or an exit code differed
+ * @return 2 - invalid arguments, or the inputs or programs were missing
+ *****************************************************************************/
+int main ( int argc, char **argv )
+{
+    string programs;                //Where the programs are
+    string work = "difftest.work";  //Where files are written
+    uint64_t size = 1 << 20;        //Bytes of random input
+    uint64_t midsize = 20000;       //Words in the midsize input
+    uint64_t distinct = 2000000;    //Words in the distinct input
+    string save;                    //Throughput file, if any
+    bool keep = false;              //If the files are left behind
+    string arg;                     //Argument being looked at
+    bool ok = true;                 //If every report matched
+
+
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        arg = argv[i];
+
+        if ( arg.compare ( 0, 11, "--programs=" ) == 0 )
+        {
+            programs = arg.substr ( 11 );
+        }
+        else if ( arg.compare ( 0, 7, "--work=" ) == 0 )
+        {
+            work = arg.substr ( 7 );
+        }
+        else if ( arg.compare ( 0, 7, "--size=" ) == 0 )
+        {
+            size = strtoull ( arg.c_str() + 7, nullptr, 10 );
+        }
+        else if ( arg.compare ( 0, 10, "--midsize=" ) == 0 )
+        {
+            midsize = strtoull ( arg.c_str() + 10, nullptr, 10 );
+        }
+        else if ( arg.compare ( 0, 11, "--distinct=" ) == 0 )
+        {
+            distinct = strtoull ( arg.c_str() + 11, nullptr, 10 );
+        }
+        else if ( arg.compare ( 0, 7, "--save=" ) == 0 )
+        {
+            save = arg.substr ( 7 );
+        }
+        else if ( arg == "--keep" )
+        {
+            keep = true;
+        }
+        else
+        {
+            cout << "Error, invalid arguments!" << endl;
+            cout << "Usage: " << argv[0] << " [--programs=DIR] [--work=DIR] "
+                 << "[--size=N] [--midsize=N] [--distinct=N] [--save=FILE] "
+                 << "[--keep]" << endl;
+            return 2;
+        }
+    }
+
+    //The programs are built next to the test by default
+    if ( programs.empty() )
+    {
+        programs = filesystem::path ( argv[0] ).parent_path().string();
+    }
+
+    if ( programs.empty() )
+    {
+        programs = ".";
+    }
+
+
+
+    vector<backend> backends =
+    {
+        { "list", "prog2", { "--backend=list", "--format=tsv" }, true, true },
+        { "stl", "prog2stl", { "--format=tsv" }, true, true },
+        { "hash", "prog2", { "--backend=hash", "--format=tsv" }, false, true },
+        {
+            "simd", "prog2_wide", { "--backend=hash", "--format=tsv" }, false,
+            true
+        },
+        {
+            "threaded", "prog2", { "--backend=hash", "--format=tsv",
+                                   "--threads=4"
+                                 }, false, true
+        }
+    };
+
+    for ( backend &b : backends )
+    {
+        b.program = programs + "/" + b.program;
+        b.available = access ( b.program.c_str(), X_OK ) == 0;
+
+        //The wide keys are compared with AVX2 instructions
+        if ( b.name == "simd" && !__builtin_cpu_supports ( "avx2" ) )
+        {
+            b.available = false;
+        }
+
+        if ( !b.available && b.name != "simd" )
+        {
+            cout << "Error, " << b.program << " was not found!" << endl;
+            return 2;
+        }
+    }
+
+
+
+    //Write the inputs
+    vector<testInput> inputs =
+    {
+        { "random", work + "/random.txt", 0, false },
+        { "punctuation", work + "/punctuation.txt", 0, false },
+        { "edges", work + "/edges.txt", 0, false },
+        { "huge", work + "/huge.txt", 0, false },
+        { "empty", work + "/empty.txt", 0, false },
+        { "blank", work + "/blank.txt", 0, false },
+        { "midsize", work + "/midsize.txt", 0, false },
+        { "distinct", work + "/distinct.txt", 0, true }
+    };
+
+    error_code failed;
+
+    filesystem::create_directories ( work, failed );
+
+    writeRandom ( inputs[0].path, size, 1 );
+    writePunctuation ( inputs[1].path, size, 2 );
+    writeEdges ( inputs[2].path );
+    writeHuge ( inputs[3].path, 3 );
+    ofstream ( inputs[4].path, ios::binary );
+    ofstream ( inputs[5].path, ios::binary ) << " \t\r\n\v\f  \n\n";
+    writeDistinct ( inputs[6].path, midsize, 5 );
+    writeDistinct ( inputs[7].path, distinct, 4 );
+
+    for ( testInput &input : inputs )
+    {
+        input.bytes = filesystem::file_size ( input.path, failed );
+
+        if ( failed )
+        {
+            cout << "Error, " << input.path << " could not be written!"
+                 << endl;
+            return 2;
+        }
+    }
+
+
+
+    //Count each input every way and compare the reports
+    ofstream fout;
+
+    if ( !save.empty() )
+    {
+        fout.open ( save.c_str() );
+        fout << "input\tbytes\tbackend\tseconds\tMB/s\tresult" << endl;
+    }
+
+    cout << left << setw ( 12 ) << "input" << right << setw ( 10 ) << "bytes"
+         << "  " << left << setw ( 10 ) << "backend" << right << setw ( 10 )
+         << "MB/s" << "  result" << endl;
+
+    for ( const testInput &input : inputs )
+    {
+        string reference;       //Report of the first backend
+        string report;          //Report of the current backend
+        int referenceCode = 0;  //Exit code of the first backend
+        bool first = true;
+
+        for ( const backend &b : backends )
+        {
+            string output = work + "/" + input.name + "." + b.name + ".out";
+            vector<string> args = b.args;
+            string result;
+            double seconds = 0;
+            int code;
+
+            cout << left << setw ( 12 ) << input.name << right << setw ( 10 )
+                 << input.bytes << "  " << left << setw ( 10 ) << b.name
+                 << right << setw ( 10 );
+
+            if ( !b.available || ( b.linear && input.manyWords ) )
+            {
+                cout << "-" << "  skipped" << endl;
+                continue;
+            }
+
+            args.push_back ( input.path );
+            args.push_back ( output );
+            code = runProgram ( b.program, args, seconds );
+
+            if ( !readFile ( output, report ) )
+            {
+                report.clear();
+            }
+
+            if ( first )
+            {
+                reference = report;
+                referenceCode = code;
+                result = "reference";
+                first = false;
+            }
+            else if ( code != referenceCode )
+            {
+                result = "DIFFERENT: exit code " + to_string ( code ) +
+                         " instead of " + to_string ( referenceCode );
+                ok = false;
+            }
+            else if ( report != reference )
+            {
+                result = "DIFFERENT: first at byte " +
+                         to_string ( firstDifference ( reference, report ) );
+                ok = false;
+            }
+            else
+            {
+                result = "same";
+            }
+
+            if ( code != 0 && result == "reference" )
+            {
+                result += ", exit code " + to_string ( code );
+            }
+
+            cout << fixed << setprecision ( 1 )
+                 << input.bytes / seconds / 1e6 << "  " << result << endl;
+
+            if ( fout.is_open() )
+            {
+                fout << input.name << '\t' << input.bytes << '\t' << b.name
+                     << '\t' << seconds << '\t'
+                     << input.bytes / seconds / 1e6 << '\t' << result << endl;
+            }
+
+            if ( !keep )
+            {
+                filesystem::remove ( output, failed );
+            }
+        }
+
+        if ( !keep )
+        {
+            filesystem::remove ( input.path, failed );
+        }
+    }
+
+    if ( !checkNdjson ( backends, work, keep ) )
+    {
+        ok = false;
+    }
+
+    if ( !keep )
+    {
+        filesystem::remove ( work, failed );
+    }
+
+    cout << ( ok ? "Every backend wrote the same reports" :
+              "Error, the backends disagree!" ) << endl;
+
+    return ok ? 0 : 1;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes random text. A few thousand words are drawn with a
+ * heavy skew toward the first ones, then dressed up: punctuation before,
+ * after and inside, random capitals, and now and then a NUL byte or a lone
+ * punctuation token. Any white space may separate them.
+ *
+ * @param[in] path - where to write
+ * @param[in] bytes - about how much to write
+ * @param[in] seed - seed for the generator
+ *
+ *****************************************************************************/
+void writeRandom ( const string &path, uint64_t bytes, unsigned seed )
+{
+    static const char PUNCT[] = "!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+    static const char *const SPACE[] = { " ", " ", " ", "  ", "\n", "\t",
+                                         "\r\n", "\v", "\f", " \n "
+                                       };
+    mt19937_64 random ( seed );
+    uniform_real_distribution<double> chance ( 0, 1 );
+    vector<string> vocabulary;
+    ofstream fout ( path, ios::binary );
+    string text;
+    string word;
+
+    for ( int i = 0; i < 3000; i++ )
+    {
+        word = makeWord ( random, 1 + random() % 12 );
+
+        //Digits and bytes above 127 in some of them
+        if ( i % 7 == 0 )
+        {
+            word += to_string ( i );
+        }
+
+        if ( i % 11 == 0 )
+        {
+            word += "\xc3\xa9";
+        }
+
+        vocabulary.push_back ( word );
+    }
+
+    while ( text.size() < bytes )
+    {
+        word = vocabulary[ ( size_t ) ( pow ( chance ( random ), 4 ) *
+                                        vocabulary.size() )];
+
+        for ( char &c : word )
+        {
+            if ( c >= 'a' && c <= 'z' && chance ( random ) < 0.2 )
+            {
+                c -= 32;
+            }
+        }
+
+        if ( chance ( random ) < 0.3 )
+        {
+            word.insert ( word.begin(), PUNCT[random() % 32] );
+        }
+
+        if ( chance ( random ) < 0.3 )
+        {
+            word += PUNCT[random() % 32];
+        }
+
+        if ( chance ( random ) < 0.05 )
+        {
+            word.insert ( random() % ( word.size() + 1 ), 1,
+                          PUNCT[random() % 32] );
+        }
+
+        if ( chance ( random ) < 0.002 )
+        {
+            word.insert ( random() % ( word.size() + 1 ), 1, '\0' );
+        }
+
+        if ( chance ( random ) < 0.01 )
+        {
+            word = string ( 1, PUNCT[random() % 32] );
+        }
+
+        text += word;
+        text += SPACE[random() % 10];
+    }
+
+    fout.write ( text.data(), text.size() );
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes tokens of one to six punctuation characters. One in
+ * ten has a letter or digit somewhere in it, which is all trimming should
+ * leave of it.
+ *
+ * @param[in] path - where to write
+ * @param[in] bytes - about how much to write
+ * @param[in] seed - seed for the generator
+ *
+ *****************************************************************************/
+void writePunctuation ( const string &path, uint64_t bytes, unsigned seed )
+{
+    static const char PUNCT[] = "!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+    static const char KEPT[] = "aZ7";
+    mt19937_64 random ( seed );
+    ofstream fout ( path, ios::binary );
+    string text;
+    string word;
+
+    while ( text.size() < bytes )
+    {
+        word.clear();
+
+        for ( size_t i = 1 + random() % 6; i > 0; i-- )
+        {
+            word += PUNCT[random() % 32];
+        }
+
+        if ( random() % 10 == 0 )
+        {
+            word.insert ( random() % ( word.size() + 1 ), 1,
+                          KEPT[random() % 3] );
+        }
+
+        text += word;
+        text += random() % 8 == 0 ? '\n' : ' ';
+    }
+
+    fout.write ( text.data(), text.size() );
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes short tokens trimming has to be careful with: lone
+ * and doubled punctuation, a single letter with punctuation on either side,
+ * quotes and apostrophes, and words with punctuation inside. The last one
+ * has no newline after it.
+ *
+ * @param[in] path - where to write
+ *
+ *****************************************************************************/
+void writeEdges ( const string &path )
+{
+    static const char *const EDGES[] = { "!", "!!", "a", "A", "a!", "!a",
+                                         "!a!", "!!a!!", "'", "''", "'a'",
+                                         "'tis", "don't", "--", "a-b", "-a-b-",
+                                         "\"quoted\"", "(x)", "...", "x...y",
+                                         "Z.", ".Z", "9", "!9", "$5.00", "...a",
+                                         "a...", "@", "#hash", "\xc3\xa9",
+                                         "!\xc3\xa9!", "\xff", "~~~~~~~~~~",
+                                         "A!B!C"
+                                       };
+    ofstream fout ( path, ios::binary );
+
+    for ( int repeat = 0; repeat < 3; repeat++ )
+    {
+        for ( const char *edge : EDGES )
+        {
+            fout << edge << '\n';
+        }
+    }
+
+    fout << "last";
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes very long words, each twice and once more in capitals
+ * with punctuation around it, among ordinary words. The lengths sit on and
+ * around 64 KiB and 4 MiB, the sizes text is read and counted in.
+ *
+ * @param[in] path - where to write
+ * @param[in] seed - seed for the generator
+ *
+ *****************************************************************************/
+void writeHuge ( const string &path, unsigned seed )
+{
+    static const size_t LENGTHS[] = { 1000, 65535, 65536, 65537, 4194303,
+                                      4194304, 4194305
+                                    };
+    mt19937_64 random ( seed );
+    ofstream fout ( path, ios::binary );
+    string word;
+
+    for ( size_t length : LENGTHS )
+    {
+        word = makeWord ( random, length );
+
+        fout << "the quick brown fox " << word << " jumps\n" << word << ' ';
+        transform ( word.begin(), word.end(), word.begin(), ::toupper );
+        fout << "\"" << word << "\"!\nover the lazy dog\n";
+    }
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes many different words, in a shuffled order, and then
+ * every third one of them again.
+ *
+ * @param[in] path - where to write
+ * @param[in] words - number of different words
+ * @param[in] seed - seed for the generator
+ *
+ *****************************************************************************/
+void writeDistinct ( const string &path, uint64_t words, unsigned seed )
+{
+    mt19937_64 random ( seed );
+    vector<uint32_t> order ( words );
+    ofstream fout ( path, ios::binary );
+    string text;
+    string word;
+
+    for ( uint64_t i = 0; i < words; i++ )
+    {
+        order[i] = ( uint32_t ) i;
+    }
+
+    shuffle ( order.begin(), order.end(), random );
+
+    for ( int pass = 0; pass < 2; pass++ )
+    {
+        for ( uint64_t i = 0; i < words; i++ )
+        {
+            uint64_t number = order[i];
+
+            if ( pass == 1 && number % 3 != 0 )
+            {
+                continue;
+            }
+
+            //Spell the number in letters, after a prefix of its own
+            word = "w";
+
+            do
+            {
+                word += ( char ) ( 'a' + number % 26 );
+                number /= 26;
+            }
+            while ( number > 0 );
+
+            text += word;
+            text += i % 10 == 9 ? '\n' : ' ';
+        }
+    }
+
+    fout.write ( text.data(), text.size() );
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function makes a random lower case word.
+ *
+ * @param[in,out] random - the generator
+ * @param[in]     length - number of letters
+ *
+ * @returns the word
+ *
+ *****************************************************************************/
+string makeWord ( mt19937_64 &random, size_t length )
+{
+    string word ( length, 'a' );
+
+    for ( char &c : word )
+    {
+        c = ( char ) ( 'a' + random() % 26 );
+    }
+
+    return word;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function runs a program, with its output thrown away, and waits for
+ * it to finish.
+ *
+ * @param[in]  program - path of the program
+ * @param[in]  args - its arguments
+ * @param[out] seconds - time it took
+ *
+ * @returns its exit code, or -1 if it did not run or did not exit
+ *
+ *****************************************************************************/
+int runProgram ( const string &program, const vector<string> &args,
+                 double &seconds )
+{
+    vector<char *> argv;
+    posix_spawn_file_actions_t actions;
+    pid_t pid;
+    int status = 0;
+    int started;
+
+    argv.push_back ( ( char * ) program.c_str() );
+
+    for ( const string &arg : args )
+    {
+        argv.push_back ( ( char * ) arg.c_str() );
+    }
+
+    argv.push_back ( nullptr );
+
+    posix_spawn_file_actions_init ( &actions );
+    posix_spawn_file_actions_addopen ( &actions, 1, "/dev/null", O_WRONLY,
+                                       0 );
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    started = posix_spawn ( &pid, program.c_str(), &actions, nullptr,
+                            argv.data(), environ );
+    posix_spawn_file_actions_destroy ( &actions );
+
+    if ( started != 0 || waitpid ( pid, &status, 0 ) != pid )
+    {
+        seconds = 0;
+        return -1;
+    }
+
+    seconds = chrono::duration<double> ( chrono::steady_clock::now() -
+                                         start ).count();
+
+    return WIFEXITED ( status ) ? WEXITSTATUS ( status ) : -1;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads a whole file.
+ *
+ * @param[in]  path - the file
+ * @param[out] contents - its bytes
+ *
+ * @returns true - the file was read
+ * @returns false - the file did not open
+ *
+ *****************************************************************************/
+bool readFile ( const string &path, string &contents )
+{
+    ifstream fin ( path, ios::binary );
+
+    if ( !fin )
+    {
+        return false;
+    }
+
+    contents.assign ( istreambuf_iterator<char> ( fin ),
+                      istreambuf_iterator<char>() );
+
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function finds where two reports stop being the same.
+ *
+ * @param[in] a - one report
+ * @param[in] b - the other
+ *
+ * @returns offset of the first byte that differs, or the length of the
+ * shorter one if it is the start of the other
+ *
+ *****************************************************************************/
+size_t firstDifference ( const string &a, const string &b )
+{
+    return ( size_t ) ( mismatch ( a.begin(), a.begin() + min ( a.size(),
+                                   b.size() ), b.begin() ).first - a.begin() );
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function checks that every backend escapes what is not valid UTF-8
+ * in an ndjson report. The words are one in Latin-1, the same one in UTF-8,
+ * one with an encoded surrogate, which UTF-8 does not allow, and one with a
+ * quote; each invalid byte has to come out as \u00 and its value.
+ *
+ * @param[in] backends - the ways of counting
+ * @param[in] work - where the input and reports are written
+ * @param[in] keep - if the files are left behind
+ *
+ * @returns true - every backend wrote the expected report
+ * @returns false - a report was different
+ *
+ *****************************************************************************/
+bool checkNdjson ( const vector<backend> &backends, const string &work,
+                   bool keep )
+{
+    static const char EXPECTED[] =
+        "{\"word\":\"caf\xc3\xa9\",\"count\":1}\n"
+        "{\"word\":\"caf\\u00e9\",\"count\":1}\n"
+        "{\"word\":\"q\\\"uote\",\"count\":1}\n"
+        "{\"word\":\"\\u00ed\\u00a0\\u0080x\",\"count\":1}\n";
+    string path = work + "/latin1.txt";
+    string report;
+    error_code failed;
+    double seconds;
+    bool ok = true;
+
+    ofstream ( path, ios::binary ) << "caf\xe9 Caf\xc3\xa9 \xed\xa0\x80x "
+                                   << "q\"uote\n";
+
+    for ( const backend &b : backends )
+    {
+        string output = work + "/latin1." + b.name + ".out";
+        vector<string> args = b.args;
+
+        if ( !b.available )
+        {
+            continue;
+        }
+
+        replace ( args.begin(), args.end(), string ( "--format=tsv" ),
+                  string ( "--format=ndjson" ) );
+        args.push_back ( path );
+        args.push_back ( output );
+
+        if ( runProgram ( b.program, args, seconds ) != 0 ||
+                !readFile ( output, report ) || report != EXPECTED )
+        {
+            cout << "Error, " << b.name
+                 << " did not escape invalid UTF-8 in ndjson!" << endl;
+            ok = false;
+        }
+
+        if ( !keep )
+        {
+            filesystem::remove ( output, failed );
+        }
+    }
+
+    if ( !keep )
+    {
+        filesystem::remove ( path, failed );
+    }
+
+    return ok;
+}
@@ -0,0 +1,876 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Implementation of the InputFile and DecompressBuf classes
+*
+* @details
+* Input files are sniffed for the gzip (1f 8b) and zstd (28 b5 2f fd) magic
+* numbers when they are opened. Plain files are passed straight through.
+* gzip files are inflated a chunk at a time, including files made of several
+* concatenated members. zstd frames are streamed a chunk at a time; when a
+* file is made of several frames, as parallel compressors write them, those
+* that record their decompressed size are decoded in parallel into buffers
+* of that size, a bounded number and size at a time, and handed to the
+* stream in file order. Nothing is ever written back to disk.
+*
+* gzip support needs HAVE_ZLIB and zstd support needs HAVE_ZSTD to be defined
+* when compiling; without them a compressed file fails to open.
+*
+******************************************************************************/
+#include "inputfile.h"
+
+#include <cstring>
+#include <thread>
+
+#ifdef HAVE_ZSTD
+#include <zstd_errors.h>
+#endif
+
+
+
+/*!
+ * @brief Number of bytes read from the file or inflated at a time
+ */
+static const size_t CHUNK_SIZE = 1 << 17;
+
+/*!
+ * @brief Most decompressed bytes of the zstd frames decoded whole on worker
+ * threads at once; a bigger frame, and a frame that does not record its
+ * size, is streamed
+ */
+static const size_t MAX_FRAMES_SIZE = 512 * CHUNK_SIZE;
+
+/*!
+ * @brief Most bytes a zstd frame header can take
+ */
+static const size_t MAX_FRAME_HEADER = 18;
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates an empty buffer with no file attached.
+ *
+ ******************************************************************************/
+DecompressBuf::DecompressBuf()
+{
+    format = PLAIN;
+    opened = false;
+    rawDone = true;
+    inPos = 0;
+    inEnd = 0;
+    maxInFlight = max ( 2u, thread::hardware_concurrency() );
+    framesSize = 0;
+#ifdef HAVE_ZLIB
+    zsReady = false;
+#endif
+#ifdef HAVE_ZSTD
+    zd = nullptr;
+    zdStreaming = false;
+#endif
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function closes the file if one is still open.
+ *
+ ******************************************************************************/
+DecompressBuf::~DecompressBuf()
+{
+    close();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function opens the given file and reads enough of it to recognize
+ * its format from the magic number at the front. The bytes read while doing
+ * so are kept and decompressed like the rest of the file. A compressed file
+ * whose library was not compiled in fails to open.
+ *
+ * @param[in] name - path of the file to open
+ *
+ * @returns true - the file was opened
+ * @returns false - the file could not be opened or its format is unsupported
+ *
+ ******************************************************************************/
+bool DecompressBuf::open ( const char *name )
+{
+    const unsigned char *magic;
+
+    close();
+
+    raw.open ( name, ios::in | ios::binary );
+
+    if ( !raw )
+    {
+        return false;
+    }
+
+    inBuf.resize ( CHUNK_SIZE );
+    inPos = 0;
+    inEnd = 0;
+    rawDone = false;
+
+    //Read until the magic number is available or the file runs out
+    while ( inEnd < 4 && readMore() )
+    {
+    }
+
+    magic = ( const unsigned char * ) inBuf.data();
+    format = PLAIN;
+
+    if ( inEnd >= 2 && magic[0] == 0x1f && magic[1] == 0x8b )
+    {
+        format = GZIP;
+    }
+    else if ( inEnd >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+              magic[2] == 0x2f && magic[3] == 0xfd )
+    {
+        format = ZSTD;
+    }
+    else if ( inEnd >= 4 && ( magic[0] & 0xf0 ) == 0x50 &&
+              magic[1] == 0x2a && magic[2] == 0x4d && magic[3] == 0x18 )
+    {
+        //Skippable frame, only zstd writes these
+        format = ZSTD;
+    }
+
+#ifdef HAVE_ZLIB
+    if ( format == GZIP )
+    {
+        memset ( &zs, 0, sizeof ( zs ) );
+
+        //15 + 32 - largest window, detect the gzip header
+        if ( inflateInit2 ( &zs, 15 + 32 ) != Z_OK )
+        {
+            raw.close();
+            return false;
+        }
+
+        zsReady = true;
+    }
+#else
+    if ( format == GZIP )
+    {
+        raw.close();
+        return false;
+    }
+#endif
+
+#ifdef HAVE_ZSTD
+    if ( format == ZSTD )
+    {
+        zd = ZSTD_createDCtx();
+        zdStreaming = false;
+
+        if ( zd == nullptr )
+        {
+            raw.close();
+            return false;
+        }
+    }
+#else
+    if ( format == ZSTD )
+    {
+        raw.close();
+        return false;
+    }
+#endif
+
+    setg ( nullptr, nullptr, nullptr );
+    opened = true;
+
+    return true;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function closes the file. Any zstd frames still being decoded are
+ * waited on and thrown away.
+ *
+ ******************************************************************************/
+void DecompressBuf::close()
+{
+    //Wait for in flight frames, errors no longer matter
+    while ( !frames.empty() )
+    {
+        frames.front().wait();
+        frames.pop_front();
+    }
+
+    framesSize = 0;
+
+#ifdef HAVE_ZLIB
+    if ( zsReady )
+    {
+        inflateEnd ( &zs );
+        zsReady = false;
+    }
+#endif
+
+#ifdef HAVE_ZSTD
+    if ( zd != nullptr )
+    {
+        ZSTD_freeDCtx ( zd );
+        zd = nullptr;
+        zdStreaming = false;
+    }
+#endif
+
+    if ( raw.is_open() )
+    {
+        raw.close();
+    }
+
+    setg ( nullptr, nullptr, nullptr );
+    inPos = 0;
+    inEnd = 0;
+    rawDone = true;
+    opened = false;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function determines if a file is currently open.
+ *
+ * @returns true if a file is open.
+ * @returns false if no file is open.
+ *
+ ******************************************************************************/
+bool DecompressBuf::is_open()
+{
+    return opened;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function passes over the next bytes of decompressed text without
+ * handing them to the stream. A plain file that has not been read from yet
+ * is simply positioned; anything else is decompressed and thrown away.
+ *
+ * @param[in] bytes - number of bytes to pass over
+ *
+ * @returns true - the bytes were passed over
+ * @returns false - the file is not open or ended first
+ *
+ ******************************************************************************/
+bool DecompressBuf::skip ( uint64_t bytes )
+{
+    streamoff length;
+    size_t step;
+
+    if ( !opened )
+    {
+        return false;
+    }
+
+    if ( format == PLAIN && eback() == nullptr )
+    {
+        raw.clear();
+        raw.seekg ( 0, ios::end );
+        length = raw.tellg();
+
+        if ( length < 0 || bytes > ( uint64_t ) length )
+        {
+            return false;
+        }
+
+        raw.seekg ( ( streamoff ) bytes );
+        inPos = 0;
+        inEnd = 0;
+        rawDone = false;
+        return true;
+    }
+
+    while ( bytes > 0 )
+    {
+        if ( gptr() == egptr() && underflow() == traits_type::eof() )
+        {
+            return false;
+        }
+
+        step = ( size_t ) min<uint64_t> ( bytes, egptr() - gptr() );
+        gbump ( ( int ) step );
+        bytes -= step;
+    }
+
+    return true;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function is called by the stream when every decompressed byte handed
+ * to it has been used. The next piece of the file is decompressed into the
+ * get area. Corrupt or truncated input throws, which the stream turns into
+ * its bad state.
+ *
+ * @returns the next character, or eof once the file is used up
+ *
+ ******************************************************************************/
+DecompressBuf::int_type DecompressBuf::underflow()
+{
+    bool filled = false;
+
+    if ( gptr() < egptr() )
+    {
+        return traits_type::to_int_type ( *gptr() );
+    }
+
+    if ( !opened )
+    {
+        return traits_type::eof();
+    }
+
+    switch ( format )
+    {
+        case PLAIN:
+            filled = fillPlain();
+            break;
+
+        case GZIP:
+            filled = fillGzip();
+            break;
+
+        case ZSTD:
+            filled = fillZstd();
+            break;
+    }
+
+    if ( !filled )
+    {
+        return traits_type::eof();
+    }
+
+    return traits_type::to_int_type ( *gptr() );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads the next chunk of the file onto the end of the unused
+ * input. Unused bytes are first moved to the front of the buffer, and the
+ * buffer is doubled if it is still full so that a small zstd frame larger
+ * than a chunk can be collected whole.
+ *
+ * @returns true - bytes were added to the input
+ * @returns false - the end of the file was reached
+ *
+ ******************************************************************************/
+bool DecompressBuf::readMore()
+{
+    streamsize got;
+
+    if ( rawDone )
+    {
+        return false;
+    }
+
+    //Slide unused bytes to the front
+    if ( inPos > 0 )
+    {
+        memmove ( inBuf.data(), inBuf.data() + inPos, inEnd - inPos );
+        inEnd -= inPos;
+        inPos = 0;
+    }
+
+    //Still full, make room
+    if ( inEnd == inBuf.size() )
+    {
+        inBuf.resize ( inBuf.size() * 2 );
+    }
+
+    raw.read ( inBuf.data() + inEnd, inBuf.size() - inEnd );
+    got = raw.gcount();
+    inEnd += ( size_t ) got;
+
+    if ( !raw )
+    {
+        rawDone = true;
+    }
+
+    return got > 0;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function hands the next chunk of an uncompressed file to the stream
+ * without copying it.
+ *
+ * @returns true - the get area was filled
+ * @returns false - the end of the file was reached
+ *
+ ******************************************************************************/
+bool DecompressBuf::fillPlain()
+{
+    if ( inPos == inEnd && !readMore() )
+    {
+        return false;
+    }
+
+    setg ( inBuf.data() + inPos, inBuf.data() + inPos, inBuf.data() + inEnd );
+    inPos = inEnd;
+
+    return true;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function inflates gzip data until at least one byte comes out or the
+ * file ends. When a member ends and more input follows, the inflater is reset
+ * so concatenated members read as one file.
+ *
+ * @returns true - the get area was filled
+ * @returns false - the end of the file was reached
+ *
+ ******************************************************************************/
+bool DecompressBuf::fillGzip()
+{
+#ifdef HAVE_ZLIB
+    int ret;
+    size_t produced;
+
+    outBuf.resize ( CHUNK_SIZE );
+
+    while ( true )
+    {
+        if ( inPos == inEnd )
+        {
+            readMore();
+        }
+
+        zs.next_in = ( Bytef * ) inBuf.data() + inPos;
+        zs.avail_in = ( uInt ) ( inEnd - inPos );
+        zs.next_out = ( Bytef * ) outBuf.data();
+        zs.avail_out = ( uInt ) outBuf.size();
+
+        ret = inflate ( &zs, Z_NO_FLUSH );
+
+        inPos = inEnd - zs.avail_in;
+        produced = outBuf.size() - zs.avail_out;
+
+        if ( ret == Z_STREAM_END )
+        {
+            //Another member may follow this one
+            if ( inPos == inEnd )
+            {
+                readMore();
+            }
+
+            if ( inPos < inEnd )
+            {
+                inflateReset ( &zs );
+            }
+        }
+        else if ( ret == Z_BUF_ERROR )
+        {
+            if ( inPos == inEnd && rawDone )
+            {
+                throw runtime_error ( "gzip input is truncated" );
+            }
+        }
+        else if ( ret != Z_OK )
+        {
+            throw runtime_error ( "gzip input is corrupt" );
+        }
+
+        if ( produced > 0 )
+        {
+            setg ( outBuf.data(), outBuf.data(), outBuf.data() + produced );
+            return true;
+        }
+
+        if ( ret == Z_STREAM_END && inPos == inEnd )
+        {
+            return false;
+        }
+    }
+#else
+    return false;
+#endif
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function hands the next piece of a zstd file to the stream. Frames
+ * already sent to the workers are used first, oldest first, and more are
+ * dispatched as soon as a slot frees up so the workers stay busy while the
+ * stream uses this one. A frame that is not sent to the workers is streamed
+ * once the frames before it are used.
+ *
+ * @returns true - the get area was filled
+ * @returns false - the end of the file was reached
+ *
+ ******************************************************************************/
+bool DecompressBuf::fillZstd()
+{
+#ifdef HAVE_ZSTD
+    while ( true )
+    {
+        if ( zdStreaming )
+        {
+            if ( streamZstd() )
+            {
+                return true;
+            }
+
+            continue;
+        }
+
+        dispatchFrames();
+
+        if ( !frames.empty() )
+        {
+            outBuf = frames.front().get();
+            frames.pop_front();
+            framesSize -= outBuf.size();
+
+            dispatchFrames();
+
+            //Skippable frames decode to nothing
+            if ( !outBuf.empty() )
+            {
+                setg ( outBuf.data(), outBuf.data(), outBuf.data() + outBuf.size() );
+                return true;
+            }
+
+            continue;
+        }
+
+        if ( inPos == inEnd && !readMore() )
+        {
+            return false;
+        }
+
+        //The next frame was not dispatched, stream it
+        zdStreaming = true;
+    }
+#else
+    return false;
+#endif
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function decodes the frame being streamed into a chunk sized buffer
+ * until at least one byte comes out or the frame ends, reading more of the
+ * file as the decoder asks for it.
+ *
+ * @returns true - the get area was filled
+ * @returns false - the frame ended without any more output
+ *
+ ******************************************************************************/
+bool DecompressBuf::streamZstd()
+{
+#ifdef HAVE_ZSTD
+    size_t ret;
+
+    outBuf.resize ( CHUNK_SIZE );
+
+    while ( true )
+    {
+        ZSTD_inBuffer in = { inBuf.data() + inPos, inEnd - inPos, 0 };
+        ZSTD_outBuffer out = { outBuf.data(), outBuf.size(), 0 };
+
+        ret = ZSTD_decompressStream ( zd, &out, &in );
+        inPos += in.pos;
+
+        if ( ZSTD_isError ( ret ) )
+        {
+            throw runtime_error ( "zstd input is corrupt" );
+        }
+
+        if ( ret == 0 )
+        {
+            //Frame is complete, the next may go to the workers
+            zdStreaming = false;
+        }
+        else if ( out.pos < out.size && inPos == inEnd && !readMore() )
+        {
+            throw runtime_error ( "zstd input is truncated" );
+        }
+
+        if ( out.pos > 0 )
+        {
+            setg ( outBuf.data(), outBuf.data(), outBuf.data() + out.pos );
+            return true;
+        }
+
+        if ( !zdStreaming )
+        {
+            return false;
+        }
+    }
+#else
+    return false;
+#endif
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function finds complete zstd frames in the input and starts decoding
+ * each on its own thread, into a buffer of the size the frame records, until
+ * maxInFlight frames are outstanding, their sizes would add up to more than
+ * MAX_FRAMES_SIZE or the file runs out. A frame that does not fit waits for
+ * the ones before it, except that one frame of up to MAX_FRAMES_SIZE is
+ * always let through. Frames that do not record their size or are bigger,
+ * and the last frame of the file when no others are outstanding, are not
+ * dispatched; dispatching stops at one so that it can be streamed in turn.
+ *
+ * @returns true - frames were dispatched or none can be
+ *
+ ******************************************************************************/
+bool DecompressBuf::dispatchFrames()
+{
+#ifdef HAVE_ZSTD
+    unsigned long long size;
+    size_t length;
+    size_t limit;
+
+    while ( !zdStreaming && frames.size() < maxInFlight )
+    {
+        if ( inPos == inEnd && !readMore() )
+        {
+            return true;
+        }
+
+        size = ZSTD_getFrameContentSize ( inBuf.data() + inPos, inEnd - inPos );
+
+        //Only part of the header is buffered, read the rest of it
+        if ( size == ZSTD_CONTENTSIZE_ERROR &&
+                inEnd - inPos < MAX_FRAME_HEADER && readMore() )
+        {
+            continue;
+        }
+
+        if ( size == ZSTD_CONTENTSIZE_ERROR ||
+                size == ZSTD_CONTENTSIZE_UNKNOWN || size > MAX_FRAMES_SIZE )
+        {
+            return true;
+        }
+
+        //Wait for room among the frames being decoded
+        if ( !frames.empty() && size > MAX_FRAMES_SIZE - framesSize )
+        {
+            return true;
+        }
+
+        limit = ZSTD_compressBound ( ( size_t ) size );
+        length = ZSTD_findFrameCompressedSize ( inBuf.data() + inPos,
+                                                inEnd - inPos );
+
+        //Only part of the frame is buffered, read the rest of it
+        while ( ZSTD_isError ( length ) &&
+                ZSTD_getErrorCode ( length ) == ZSTD_error_srcSize_wrong &&
+                inEnd - inPos < limit && readMore() )
+        {
+            length = ZSTD_findFrameCompressedSize ( inBuf.data() + inPos,
+                                                    inEnd - inPos );
+        }
+
+        //Leave a lone last frame, and any problem, to the stream
+        if ( ZSTD_isError ( length ) || ( frames.empty() && rawDone &&
+                                          inPos + length == inEnd ) )
+        {
+            return true;
+        }
+
+        vector<char> frame ( inBuf.begin() + inPos,
+                             inBuf.begin() + inPos + length );
+        inPos += length;
+        framesSize += ( size_t ) size;
+
+        frames.push_back ( async ( launch::async, decodeFrame, move ( frame ) ) );
+    }
+#endif
+
+    return true;
+}
+
+
+
+#ifdef HAVE_ZSTD
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function decodes a single zstd frame whose decompressed size is
+ * recorded in it and is at most MAX_FRAMES_SIZE.
+ *
+ * @param[in] frame - the compressed frame
+ *
+ * @returns the decompressed bytes of the frame
+ *
+ ******************************************************************************/
+vector<char> DecompressBuf::decodeFrame ( vector<char> frame )
+{
+    vector<char> out;
+    size_t ret;
+
+    out.resize ( ( size_t ) ZSTD_getFrameContentSize ( frame.data(),
+                 frame.size() ) );
+    ret = ZSTD_decompress ( out.data(), out.size(), frame.data(), frame.size() );
+
+    if ( ZSTD_isError ( ret ) )
+    {
+        throw runtime_error ( "zstd input is corrupt" );
+    }
+
+    out.resize ( ret );
+
+    return out;
+}
+#endif
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates a stream with no file attached.
+ *
+ ******************************************************************************/
+InputFile::InputFile() : istream ( nullptr )
+{
+    rdbuf ( &buf );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function opens the given file. The stream's fail state is set if the
+ * file could not be opened, just like ifstream.
+ *
+ * @param[in] name - path of the file to open
+ *
+ ******************************************************************************/
+void InputFile::open ( const char *name )
+{
+    if ( buf.open ( name ) )
+    {
+        clear();
+    }
+    else
+    {
+        setstate ( ios::failbit );
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function closes the file.
+ *
+ ******************************************************************************/
+void InputFile::close()
+{
+    buf.close();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function determines if a file is currently open.
+ *
+ * @returns true if a file is open.
+ * @returns false if no file is open.
+ *
+ ******************************************************************************/
+bool InputFile::is_open()
+{
+    return buf.is_open();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function passes over the next bytes of the file's text, as if they
+ * had been read. A plain file is positioned without reading it when
+ * nothing has been read from it yet.
+ *
+ * @param[in] bytes - number of bytes to pass over
+ *
+ * @returns true - the bytes were passed over
+ * @returns false - the file ended first, or is corrupt; the stream is
+ * failed or bad
+ *
+ ******************************************************************************/
+bool InputFile::skip ( uint64_t bytes )
+{
+    try
+    {
+        if ( buf.skip ( bytes ) )
+        {
+            return true;
+        }
+
+        setstate ( ios::failbit );
+    }
+    catch ( exception & )
+    {
+        setstate ( ios::badbit );
+    }
+
+    return false;
+}
@@ -0,0 +1,111 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Definition of the InputFile and DecompressBuf classes
+*
+******************************************************************************/
+
+#include <istream>
+#include <streambuf>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <cstdint>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+#ifndef __INPUTFILE_H
+#define __INPUTFILE_H
+
+/*!
+ * @brief stream buffer that reads a plain, gzip or zstd file and hands the
+ * decompressed bytes to whoever is extracting from the stream
+ */
+class DecompressBuf : public streambuf
+{
+    public:
+        DecompressBuf();
+        ~DecompressBuf();
+
+        bool open ( const char *name );
+        void close();
+        bool is_open();
+        bool skip ( uint64_t bytes );
+
+    protected:
+        int_type underflow();
+
+    private:
+        /*!
+        * @brief Format of the file detected from its leading magic bytes
+        */
+        enum fileFormat
+        {
+            PLAIN,              /*!< Not compressed, read straight through */
+            GZIP,               /*!< One or more gzip members */
+            ZSTD                /*!< One or more zstd frames */
+        };
+
+        bool readMore();
+        bool fillPlain();
+        bool fillGzip();
+        bool fillZstd();
+        bool streamZstd();
+        bool dispatchFrames();
+
+#ifdef HAVE_ZSTD
+        static vector<char> decodeFrame ( vector<char> frame );
+#endif
+
+        ifstream raw;           /*!< The file as stored on disk */
+        fileFormat format;      /*!< Format detected when the file opened */
+        bool opened;            /*!< If a file is currently open */
+        bool rawDone;           /*!< If every byte of the file has been read */
+        vector<char> inBuf;     /*!< Bytes read from the file not yet used */
+        size_t inPos;           /*!< First unused byte in inBuf */
+        size_t inEnd;           /*!< One past the last valid byte in inBuf */
+        vector<char> outBuf;    /*!< Decompressed bytes handed to the stream */
+        size_t maxInFlight;     /*!< zstd frames allowed to decode at once */
+        deque<future<vector<char>>> frames; /*!< zstd frames being decoded */
+        size_t framesSize;      /*!< Decompressed size of those frames */
+#ifdef HAVE_ZLIB
+        z_stream zs;            /*!< zlib state for the current gzip member */
+        bool zsReady;           /*!< If zs has been initialized */
+#endif
+#ifdef HAVE_ZSTD
+        ZSTD_DCtx *zd;          /*!< zstd state for the frame being streamed */
+        bool zdStreaming;       /*!< If a frame is part way through zd */
+#endif
+};
+
+
+
+/*!
+ * @brief input file stream that transparently decompresses gzip and zstd
+ * files; used anywhere an ifstream would be used to read words
+ */
+class InputFile : public istream
+{
+    public:
+        InputFile();
+
+        void open ( const char *name );
+        void close();
+        bool is_open();
+        bool skip ( uint64_t bytes );
+
+    private:
+        DecompressBuf buf;      /*!< Buffer doing the reading */
+};
+
+#endif
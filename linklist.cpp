@@ -12,12 +12,15 @@
  * @author Christian Fattig
  *
  * @par Description:
- * This function creates a list by initializing headptr to nullptr.
+ * This function creates a list by initializing headptr and the frequency
+ * buckets to nullptr.
  *
  ******************************************************************************/
 LinkList::LinkList()
 {
     headptr = nullptr;
+    lowest = nullptr;
+    highest = nullptr;
 }
 
 
@@ -27,12 +30,14 @@ LinkList::LinkList()
  *
  * @par Description:
  * This function walks through a given list deleting one node at a
- * time until the entire list has been freed up.
+ * time until the entire list has been freed up. The frequency buckets are
+ * then freed the same way.
  *
  ******************************************************************************/
 LinkList::~LinkList()
 {
     node *temp;
+    bucket *group;
     
     while ( headptr != nullptr )
     {
@@ -40,6 +45,13 @@ LinkList::~LinkList()
         headptr = temp->next;
         delete temp;
     }
+    
+    while ( lowest != nullptr )
+    {
+        group = lowest;
+        lowest = group->higher;
+        delete group;
+    }
 }
 
 
@@ -55,7 +67,9 @@ LinkList::~LinkList()
  * the list properly. If the node is being added at the front of the list,
  * headptr is adjusted to point to the new node and the node. If not, the
  * previous node it pointed to the new one. Next, the new node is pointed to
- * the rest of the list.
+ * the rest of the list. Words too long for the node's key are copied to the
+ * side pool of long words. Finally, the node joins the bucket for frequency 1,
+ * which is created if no other word has that frequency.
  *
  * @param[in] word - word to add to the list
  *
@@ -83,13 +97,37 @@ bool LinkList::insert ( string word )
     
     //Set contents of the new node
     newNode->frequencyCount = 1;
-    newNode->word = word;
     newNode->next = nullptr;
     
+    if ( !makeKey ( word.data(), word.length(), newNode->word ) )
+    {
+        try
+        {
+            spillKey ( word.data(), word.length(), longWords, newNode->word );
+        }
+        catch ( bad_alloc & )
+        {
+            delete newNode;
+            return false;
+        }
+    }
+    
+    //Frequency 1 is always the lowest, make its bucket if needed
+    if ( lowest == nullptr || lowest->frequency != 1 )
+    {
+        if ( addBucket ( 1, nullptr ) == nullptr )
+        {
+            delete newNode;
+            return false;
+        }
+    }
+    
+    joinBucket ( newNode, lowest );
+    
 
 
     //While the current word comes after and not at the end
-    while ( curr != nullptr && newNode->word > curr->word )
+    while ( curr != nullptr && keyLess ( curr->word, newNode->word, longWords ) )
     {
         prev = curr;
         curr = curr->next;
@@ -134,6 +172,9 @@ bool LinkList::remove ( string word )
     // declare & initialize temporary pointers used to walk through list
     node *prev = headptr;
     node *curr = headptr;
+    wordKey probe;
+    
+    makeKey ( word.data(), word.length(), probe );
     
     // check for empty list
     if ( headptr == nullptr )
@@ -142,7 +183,7 @@ bool LinkList::remove ( string word )
     }
     
     // move pointers down as necessary
-    while ( curr != nullptr && curr->word != word )
+    while ( curr != nullptr && !sameWord ( curr, probe, word ) )
     {
         prev = curr;
         
@@ -157,6 +198,7 @@ bool LinkList::remove ( string word )
     
     // adjust list so chosen word drops out
     prev->next = curr->next;
+    leaveBucket ( curr );
     
     if ( curr == headptr )
     {
@@ -186,12 +228,14 @@ bool LinkList::remove ( string word )
 bool LinkList::find ( string word )
 {
     node *temp;
+    wordKey probe;
     
     temp = headptr;
+    makeKey ( word.data(), word.length(), probe );
     
     while ( temp != nullptr ) //searches through the list
     {
-        if ( temp->word == word ) //compares the words
+        if ( sameWord ( temp, probe, word ) ) //compares the words
         {
             return true;
         }
@@ -209,24 +253,47 @@ bool LinkList::find ( string word )
  *
  * @par Description:
  * This function will search for the word in the input and, if it is found,
- * increment the frequency counter for that word.
+ * increment the frequency counter for that word. The word moves up to the
+ * bucket for its new frequency, which is created right above its old one if
+ * no other word has that frequency yet.
  *
  * @param[in] word - word to increment the counter for
  *
- * @return true if counter incremented, false otherwise
+ * @return true if counter incremented, false otherwise (not found or memory
+ * error)
  *
  ******************************************************************************/
 bool LinkList::incrementFrequency ( string word )
 {
     // assign temporary pointer to walk through list
     node *temp = headptr;
+    bucket *group = nullptr;
+    wordKey probe;
+    
+    makeKey ( word.data(), word.length(), probe );
     
     // walk through list
     while ( temp != nullptr )
     {
         // if word is found, increment counter & return true
-        if ( temp->word == word )
+        if ( sameWord ( temp, probe, word ) )
         {
+            group = temp->group->higher;
+            
+            // next bucket up is not the next frequency, add it
+            if ( group == nullptr ||
+                    group->frequency != temp->frequencyCount + 1 )
+            {
+                group = addBucket ( temp->frequencyCount + 1, temp->group );
+                
+                if ( group == nullptr )
+                {
+                    return false;
+                }
+            }
+            
+            leaveBucket ( temp );
+            joinBucket ( temp, group );
             temp->frequencyCount = temp->frequencyCount + 1;
             return true;
         }
@@ -269,31 +336,21 @@ bool LinkList::isEmpty()
  *
  * @par Description:
  * This function finds and returns the largest frequency occuring in the list.
- * The function traverses the list linearly and compares frequencies until at
- * the end of the list. The largest frequency is returned.
+ * The buckets are kept in order of frequency, so this is the frequency of the
+ * highest bucket.
  *
  * @return Maximum frequency found in the list
  *
  ******************************************************************************/
 int LinkList::getMaxFrequency()
 {
-    node *temp = headptr;
-    int max = 0;
-    
-    //Walk through list until at the end of the list
-    while ( temp != nullptr )
+    //Empty list has no buckets
+    if ( highest == nullptr )
     {
-        //Update max if this element's frequency is greater
-        if ( temp->frequencyCount > max )
-        {
-            max = temp->frequencyCount;
-        }
-        
-        //Go to next element
-        temp = temp->next;
+        return 0;
     }
     
-    return max;
+    return highest->frequency;
 }
 
 
@@ -331,57 +388,322 @@ int LinkList::size()
  * This function takes the given list and displays it to the screen
  * in decreasing word frequency count. The frequency of the given words
  * is displayed in a nicely formatted header followed by all the words
- * that had that frequency value.
+ * that had that frequency value. The buckets are walked from the highest
+ * frequency down, and each bucket's words are sorted alphabetically before
+ * they are displayed. Formats other than columns write the same words in
+ * the same order as records.
  *
  * @param[out] out - where the function prints to
+ * @param[in] format - layout of the report
  *
  ******************************************************************************/
-void LinkList::print ( ostream &out )
+void LinkList::print ( ostream &out, reportFormat format )
 {
-    node *temp = headptr;
-    int max = 0; // finds highest frequency count
-    bool check = false; // used for displaying frequency header
-    int count = 0; // used for formatting into collumns
+    bucket *group = highest; // bucket being displayed
+    vector<node *> words; // words in the bucket, to be sorted
+    ReportWriter report ( out, format ); // formats the headers and collumns
+    
     
-    max = getMaxFrequency();//finds highest frequency
+    while ( group != nullptr ) //traverses buckets from highest frequency
+    {
+        printBucket ( group, 0, UINT64_MAX, words, report );
+        group = group->lower;
+    }
     
+    report.finish();
     
-    for ( int i = max; i > 0; i-- ) //traverses list "max" amount of times
+    return;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes the same report as print, using several threads. The
+ * words are split into ranges holding about the same number of words,
+ * cutting a bucket too large for one range, and each thread formats one
+ * range; the ranges are then written to the file in order.
+ *
+ * @param[in] fd - file to write, from its start
+ * @param[in] format - layout of the report
+ * @param[in] threads - number of threads to use
+ *
+ * @returns true - the report was written
+ * @returns false - memory ran out or a write failed
+ *
+ ******************************************************************************/
+bool LinkList::print ( int fd, reportFormat format, unsigned threads )
+{
+    vector<bucket *> groups; // buckets from highest frequency down
+    vector<uint64_t> sizes; // words in each bucket
+    vector<reportPlace> bounds; // where each range starts
+    uint64_t count = 0; // words in the bucket being counted
+    
+    
+    for ( bucket *group = highest; group != nullptr; group = group->lower )
     {
         count = 0;
-        temp = headptr;
         
-        while ( temp != nullptr )
+        for ( node *temp = group->first; temp != nullptr; temp = temp->groupNext )
         {
-            if ( temp->frequencyCount == i && check == false ) //displays header
-            {
-                out << endl << endl << "===================================" <<
-                    "============================================" << endl;
-                out << "          Frequency Count: " << i << endl;
-                out << "===================================" <<
-                    "============================================" << endl;
-                check = true;
-            }
+            count++;
+        }
+        
+        groups.push_back ( group );
+        sizes.push_back ( count );
+    }
+    
+    bounds = splitRanges ( sizes, threads );
+    
+    return writeSegments ( fd, ( unsigned ) bounds.size() - 1,
+                           [&] ( unsigned segment, ostream &out )
+    {
+        vector<node *> words; // words in the bucket, to be sorted
+        ReportWriter report ( out, format, segment == 0 );
+        reportPlace from = bounds[segment]; // where the range starts
+        reportPlace to = bounds[segment + 1]; // where the next one starts
+        uint64_t first; // words of the bucket written by earlier ranges
+        uint64_t last; // words of the bucket written by this one and earlier
+        
+        for ( size_t i = from.group; i < groups.size() && i <= to.group; i++ )
+        {
+            first = i == from.group ? from.item : 0;
+            last = i == to.group ? to.item : sizes[i];
             
-            if ( temp->frequencyCount == i ) //displays words
+            if ( first < last )
             {
-                //spacing for collumns
-                out << left << setw ( 35 ) << left << temp->word << left << setw ( 35 );
-                count++;
-                
-                if ( count % 2 == 0 ) // used for inserting endline after 2 words printed
-                {
-                    out << endl;
-                }
+                printBucket ( groups[i], first, last - first, words, report );
             }
-            
-            temp = temp->next;
         }
         
-        check = false;
+        report.finish ( segment + 2 == bounds.size() );
+    } );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates an empty bucket for a frequency and links it into
+ * the bucket list right above the given bucket.
+ *
+ * @param[in] frequency - frequency of the new bucket
+ * @param[in] below - bucket to link above, nullptr for the bottom
+ *
+ * @returns the new bucket, nullptr if memory could not be allocated
+ *
+ ******************************************************************************/
+LinkList::bucket *LinkList::addBucket ( int frequency, bucket *below )
+{
+    bucket *group = new ( nothrow ) bucket;
+    
+    if ( group == nullptr )
+    {
+        return nullptr;
     }
     
-    out << endl << endl;
+    group->frequency = frequency;
+    group->first = nullptr;
+    group->lower = below;
+    group->higher = below == nullptr ? lowest : below->higher;
     
-    return;
+    //Link the neighbors to the new bucket
+    if ( group->lower == nullptr )
+    {
+        lowest = group;
+    }
+    else
+    {
+        group->lower->higher = group;
+    }
+    
+    if ( group->higher == nullptr )
+    {
+        highest = group;
+    }
+    else
+    {
+        group->higher->lower = group;
+    }
+    
+    return group;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function adds a node to the front of a bucket's words.
+ *
+ * @param[in,out] item - the node
+ * @param[in,out] group - the bucket it joins
+ *
+ ******************************************************************************/
+void LinkList::joinBucket ( node *item, bucket *group )
+{
+    item->group = group;
+    item->groupPrev = nullptr;
+    item->groupNext = group->first;
+    
+    if ( group->first != nullptr )
+    {
+        group->first->groupPrev = item;
+    }
+    
+    group->first = item;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function takes a node out of its bucket. A bucket left with no words
+ * is unlinked from the bucket list and freed.
+ *
+ * @param[in,out] item - the node
+ *
+ ******************************************************************************/
+void LinkList::leaveBucket ( node *item )
+{
+    bucket *group = item->group;
+    
+    if ( item->groupPrev == nullptr )
+    {
+        group->first = item->groupNext;
+    }
+    else
+    {
+        item->groupPrev->groupNext = item->groupNext;
+    }
+    
+    if ( item->groupNext != nullptr )
+    {
+        item->groupNext->groupPrev = item->groupPrev;
+    }
+    
+    item->group = nullptr;
+    
+    //Still has words
+    if ( group->first != nullptr )
+    {
+        return;
+    }
+    
+    if ( group->lower == nullptr )
+    {
+        lowest = group->higher;
+    }
+    else
+    {
+        group->lower->higher = group->higher;
+    }
+    
+    if ( group->higher == nullptr )
+    {
+        highest = group->lower;
+    }
+    else
+    {
+        group->higher->lower = group->lower;
+    }
+    
+    delete group;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function displays the header for a bucket's frequency followed by
+ * the bucket's words, sorted alphabetically. A report written in parts may
+ * display only some of the words; the header goes with the first of them.
+ *
+ * @param[in] group - the bucket
+ * @param[in] first - words in alphabetical order to leave out
+ * @param[in] limit - most words to display after them
+ * @param[in,out] words - scratch space for sorting the words
+ * @param[in,out] report - where the bucket is displayed
+ *
+ ******************************************************************************/
+void LinkList::printBucket ( bucket *group, uint64_t first, uint64_t limit,
+                             vector<node *> &words, ReportWriter &report )
+{
+    auto byWord = [this] ( node *l, node *r )
+    {
+        return keyLess ( l->word, r->word, longWords );
+    };
+    vector<node *>::iterator start; // first word displayed
+    vector<node *>::iterator stop; // one past the last word displayed
+    
+    
+    words.clear();
+    
+    for ( node *temp = group->first; temp != nullptr; temp = temp->groupNext )
+    {
+        words.push_back ( temp );
+    }
+    
+    start = words.begin() + min<uint64_t> ( first, words.size() );
+    stop = start + min<uint64_t> ( limit, words.end() - start );
+    
+    //Only the words displayed are sorted
+    if ( start != words.begin() )
+    {
+        nth_element ( words.begin(), start, words.end(), byWord );
+    }
+    
+    if ( stop == words.end() )
+    {
+        sort ( start, stop, byWord );
+    }
+    else
+    {
+        partial_sort ( start, stop, words.end(), byWord );
+    }
+    
+    report.frequency ( group->frequency, first ); //displays header
+    
+    for ( ; start != stop; start++ ) //displays words
+    {
+        report.word ( keyWord ( ( *start )->word, longWords ) );
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function tells if a node holds a word. A short word is matched by
+ * comparing keys; a long word is matched against the node's copy in the
+ * side pool.
+ *
+ * @param[in] item - the node
+ * @param[in] probe - the word's key, from makeKey
+ * @param[in] word - the word
+ *
+ * @returns true if the node holds the word
+ * @returns false if it holds another word
+ *
+ ******************************************************************************/
+bool LinkList::sameWord ( node *item, wordKey &probe, string &word )
+{
+    if ( !isLongKey ( probe ) )
+    {
+        return sameKey ( item->word, probe );
+    }
+    
+    return isLongKey ( item->word ) &&
+           keyWord ( item->word, longWords ) == word;
 }
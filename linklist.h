@@ -10,6 +10,11 @@
 #include <string>
 #include <fstream>
 #include <cctype>
+#include <vector>
+#include <algorithm>
+
+#include "report.h"
+#include "wordkey.h"
 
 using namespace std;
 
@@ -33,19 +38,48 @@ class LinkList
         bool isEmpty();
         int getMaxFrequency();
         int size();
-        void print ( ostream &out );
+        void print ( ostream &out, reportFormat format = COLUMNS_FORMAT );
+        bool print ( int fd, reportFormat format, unsigned threads );
         
     private:
+        struct bucket;
+        
         /*!
         * @brief Used to store the contents of an element in the list
         */
         struct node
         {
             int frequencyCount; /*!< Number of times the word occurs */
-            string word;        /*!< The word for this element */
+            wordKey word;       /*!< The word for this element, inline if short */
             node *next;         /*!< Pointer to the next list item */
+            node *groupPrev;    /*!< Previous word with the same frequency */
+            node *groupNext;    /*!< Next word with the same frequency */
+            bucket *group;      /*!< Bucket for this word's frequency */
         };
+        
+        /*!
+        * @brief Used to group the words that have the same frequency; the
+        * buckets form their own list in increasing frequency
+        */
+        struct bucket
+        {
+            int frequency;      /*!< Frequency shared by the words */
+            node *first;        /*!< First word in the bucket */
+            bucket *lower;      /*!< Bucket for the next lower frequency */
+            bucket *higher;     /*!< Bucket for the next higher frequency */
+        };
+        
+        bucket *addBucket ( int frequency, bucket *below );
+        void joinBucket ( node *item, bucket *group );
+        void leaveBucket ( node *item );
+        void printBucket ( bucket *group, uint64_t first, uint64_t limit,
+                           vector<node *> &words, ReportWriter &report );
+        bool sameWord ( node *item, wordKey &probe, string &word );
+        
         node *headptr;          /*!< Pointer to beginnig of list */
+        vector<char> longWords; /*!< Words too long for a key */
+        bucket *lowest;         /*!< Bucket with the lowest frequency */
+        bucket *highest;        /*!< Bucket with the highest frequency */
 };
 
 #endif
\ No newline at end of file
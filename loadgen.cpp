@@ -0,0 +1,480 @@
+/**************************************************************************//**
+ * @file
+ * @brief Entry point for the word frequency server load generator
+ *
+ * @details
+ * The load generator opens several connections to a running wordfreqd and
+ * sends requests on each as fast as the replies come back, one outstanding
+ * request per connection. Every request is timed from the moment it is
+ * written until its whole reply has been read. The words queried are taken
+ * from the server's own TOP list so most of them are found.
+ *
+ * When every connection is done, throughput and the p50, p90, p99 and p99.9
+ * latencies are displayed.
+ *
+ * @par Usage:
+ @verbatim
+ loadgen socket [--connections=N] [--requests=N] [--query=count|top|freq|mix]
+ socket - path of the server's Unix domain socket
+ --connections - concurrent connections, each on its own thread (4)
+ --requests - requests sent on each connection (100000)
+ --query - kind of request to send (count)
+ @endverbatim
+ *
+ *****************************************************************************/
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+
+/*!
+ * @brief Used to read replies a line at a time from a socket
+ */
+struct connection
+{
+    int fd;             /*!< The socket */
+    string buffer;      /*!< Bytes received, not yet used */
+    size_t pos;         /*!< First unused byte of buffer */
+};
+
+
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+bool connectTo ( const char *path, connection &conn );
+bool sendAll ( connection &conn, const string &request );
+bool readLine ( connection &conn, string &line );
+bool readReply ( connection &conn, bool multiLine );
+void runClient ( const char *path, const vector<string> &words,
+                 const vector<uint64_t> &counts, const string &query,
+                 int requests, unsigned seed, vector<uint64_t> &latencies,
+                 bool &ok );
+uint64_t percentile ( const vector<uint64_t> &sorted, double p );
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This is the starting point for the load generator. The arguments are read
+ * and the query vocabulary is fetched from the server. One thread per
+ * connection then sends its requests, and the merged latencies are sorted
+ * and summarized.
+ *
+ * @param[in] argc - count of arguments in argv
+ * @param[in] argv - array of arguments read from the command line
+ *
+ * @return 0 - every request was answered
+ * @return 1 - invalid arguments present
+ * @return 2 - the server could not be reached or stopped answering
+ *****************************************************************************/
+int main ( int argc, char **argv )
+{
+    const char *path = nullptr;     //Server socket
+    int connections = 4;            //Number of concurrent connections
+    int requests = 100000;          //Requests per connection
+    string query = "count";         //Kind of request to send
+    vector<string> words;           //Words to query
+    vector<uint64_t> counts;        //Their counts, for FREQ requests
+    connection conn;                //Connection used to fetch the words
+    string line;                    //Reply line
+    string arg;                     //Argument being looked at
+    uint64_t n = 0;
+
+
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        arg = argv[i];
+
+        if ( arg.compare ( 0, 14, "--connections=" ) == 0 )
+        {
+            connections = atoi ( arg.c_str() + 14 );
+        }
+        else if ( arg.compare ( 0, 11, "--requests=" ) == 0 )
+        {
+            requests = atoi ( arg.c_str() + 11 );
+        }
+        else if ( arg.compare ( 0, 8, "--query=" ) == 0 )
+        {
+            query = arg.substr ( 8 );
+        }
+        else if ( path == nullptr && arg.compare ( 0, 2, "--" ) != 0 )
+        {
+            path = argv[i];
+        }
+        else
+        {
+            path = nullptr;
+            break;
+        }
+    }
+
+    if ( path == nullptr || connections < 1 || requests < 1 ||
+            ( query != "count" && query != "top" && query != "freq" &&
+              query != "mix" ) )
+    {
+        cout << "Error, invalid arguments!" << endl;
+        cout << "Usage: " << argv[0] << " socket [--connections=N] "
+             << "[--requests=N] [--query=count|top|freq|mix]" << endl;
+        return 1;
+    }
+
+
+
+    //Query the words the server knows best
+    if ( !connectTo ( path, conn ) || !sendAll ( conn, "TOP 10000\n" ) ||
+            !readLine ( conn, line ) )
+    {
+        cout << "Error, could not reach the server!" << endl;
+        return 2;
+    }
+
+    n = strtoull ( line.c_str(), nullptr, 10 );
+
+    for ( uint64_t i = 0; i < n && readLine ( conn, line ); i++ )
+    {
+        size_t space = line.find ( ' ' );
+
+        counts.push_back ( strtoull ( line.c_str(), nullptr, 10 ) );
+        words.push_back ( line.substr ( space + 1 ) );
+    }
+
+    close ( conn.fd );
+
+    if ( words.empty() )
+    {
+        words.push_back ( "the" );
+        counts.push_back ( 1 );
+    }
+
+
+
+    vector<vector<uint64_t>> latencies ( connections );
+    vector<thread> threads;
+    vector<char> ok ( connections, 0 );
+    vector<uint64_t> all;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    for ( int i = 0; i < connections; i++ )
+    {
+        threads.emplace_back ( [&, i]
+        {
+            bool done = false;
+
+            runClient ( path, words, counts, query, requests, i + 1,
+                        latencies[i], done );
+            ok[i] = done;
+        } );
+    }
+
+    for ( thread &t : threads )
+    {
+        t.join();
+    }
+
+    double seconds = chrono::duration<double> ( chrono::steady_clock::now() -
+                     start ).count();
+
+    for ( int i = 0; i < connections; i++ )
+    {
+        if ( !ok[i] )
+        {
+            cout << "Error, the server stopped answering!" << endl;
+            return 2;
+        }
+
+        all.insert ( all.end(), latencies[i].begin(), latencies[i].end() );
+    }
+
+    sort ( all.begin(), all.end() );
+
+
+
+    cout << fixed << setprecision ( 1 );
+    cout << "requests:    " << all.size() << " over " << connections
+         << " connections" << endl;
+    cout << "throughput:  " << all.size() / seconds << " requests/s" << endl;
+    cout << "p50:         " << percentile ( all, 0.50 ) / 1000.0 << " us"
+         << endl;
+    cout << "p90:         " << percentile ( all, 0.90 ) / 1000.0 << " us"
+         << endl;
+    cout << "p99:         " << percentile ( all, 0.99 ) / 1000.0 << " us"
+         << endl;
+    cout << "p99.9:       " << percentile ( all, 0.999 ) / 1000.0 << " us"
+         << endl;
+    cout << "max:         " << all.back() / 1000.0 << " us" << endl;
+
+    return 0;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function connects to the server.
+ *
+ * @param[in]  path - the server's socket
+ * @param[out] conn - the new connection
+ *
+ * @returns true - connected
+ * @returns false - the server could not be reached
+ *
+ *****************************************************************************/
+bool connectTo ( const char *path, connection &conn )
+{
+    sockaddr_un addr = {};
+
+    conn.fd = socket ( AF_UNIX, SOCK_STREAM, 0 );
+    conn.buffer.clear();
+    conn.pos = 0;
+
+    if ( conn.fd < 0 || strlen ( path ) >= sizeof ( addr.sun_path ) )
+    {
+        return false;
+    }
+
+    addr.sun_family = AF_UNIX;
+    strcpy ( addr.sun_path, path );
+
+    return connect ( conn.fd, ( sockaddr * ) &addr, sizeof ( addr ) ) == 0;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes a whole request to the server.
+ *
+ * @param[in,out] conn - the connection
+ * @param[in]     request - the request, newline included
+ *
+ * @returns true - the request was sent
+ * @returns false - the connection failed
+ *
+ *****************************************************************************/
+bool sendAll ( connection &conn, const string &request )
+{
+    size_t done = 0;
+    ssize_t sent;
+
+    while ( done < request.size() )
+    {
+        sent = write ( conn.fd, request.data() + done, request.size() - done );
+
+        if ( sent <= 0 )
+        {
+            return false;
+        }
+
+        done += ( size_t ) sent;
+    }
+
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads the next line of a reply, without its newline.
+ *
+ * @param[in,out] conn - the connection
+ * @param[out]    line - the line
+ *
+ * @returns true - a line was read
+ * @returns false - the connection closed first
+ *
+ *****************************************************************************/
+bool readLine ( connection &conn, string &line )
+{
+    char chunk[65536];
+    size_t newline;
+    ssize_t got;
+
+    while ( ( newline = conn.buffer.find ( '\n', conn.pos ) ) == string::npos )
+    {
+        //Drop what has been used before reading more
+        conn.buffer.erase ( 0, conn.pos );
+        conn.pos = 0;
+
+        got = read ( conn.fd, chunk, sizeof ( chunk ) );
+
+        if ( got <= 0 )
+        {
+            return false;
+        }
+
+        conn.buffer.append ( chunk, ( size_t ) got );
+    }
+
+    line.assign ( conn.buffer, conn.pos, newline - conn.pos );
+    conn.pos = newline + 1;
+
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads a whole reply. Multi line replies start with the
+ * number of lines that follow.
+ *
+ * @param[in,out] conn - the connection
+ * @param[in]     multiLine - if the reply is a TOP or FREQ reply
+ *
+ * @returns true - the reply was read
+ * @returns false - the connection closed first
+ *
+ *****************************************************************************/
+bool readReply ( connection &conn, bool multiLine )
+{
+    string line;
+    uint64_t lines;
+
+    if ( !readLine ( conn, line ) )
+    {
+        return false;
+    }
+
+    if ( !multiLine )
+    {
+        return true;
+    }
+
+    lines = strtoull ( line.c_str(), nullptr, 10 );
+
+    for ( uint64_t i = 0; i < lines; i++ )
+    {
+        if ( !readLine ( conn, line ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function runs one connection: it sends the requests one at a time,
+ * waiting for each reply, and records how long each took in nanoseconds.
+ *
+ * @param[in]  path - the server's socket
+ * @param[in]  words - words to query
+ * @param[in]  counts - their counts, for FREQ requests
+ * @param[in]  query - count, top, freq or mix
+ * @param[in]  requests - number of requests to send
+ * @param[in]  seed - seed for choosing words
+ * @param[out] latencies - time taken by each request
+ * @param[out] ok - if every request was answered
+ *
+ *****************************************************************************/
+void runClient ( const char *path, const vector<string> &words,
+                 const vector<uint64_t> &counts, const string &query,
+                 int requests, unsigned seed, vector<uint64_t> &latencies,
+                 bool &ok )
+{
+    connection conn;
+    mt19937 random ( seed );
+    uniform_int_distribution<size_t> pick ( 0, words.size() - 1 );
+    string request;
+    string kind;
+    size_t index;
+
+    ok = false;
+    latencies.reserve ( requests );
+
+    if ( !connectTo ( path, conn ) )
+    {
+        return;
+    }
+
+    for ( int i = 0; i < requests; i++ )
+    {
+        static const char *const MIX[] = { "count", "count", "count", "top",
+                                           "freq"
+                                         };
+
+        kind = query == "mix" ? MIX[i % 5] : query;
+        index = pick ( random );
+
+        if ( kind == "count" )
+        {
+            request = "COUNT " + words[index] + "\n";
+        }
+        else if ( kind == "top" )
+        {
+            request = "TOP 10\n";
+        }
+        else
+        {
+            request = "FREQ " + to_string ( counts[index] ) + "\n";
+        }
+
+        chrono::steady_clock::time_point sent = chrono::steady_clock::now();
+
+        if ( !sendAll ( conn, request ) || !readReply ( conn, kind != "count" ) )
+        {
+            close ( conn.fd );
+            return;
+        }
+
+        latencies.push_back ( ( uint64_t ) chrono::duration_cast<chrono::nanoseconds>
+                              ( chrono::steady_clock::now() - sent ).count() );
+    }
+
+    close ( conn.fd );
+    ok = true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function picks a percentile out of sorted latencies.
+ *
+ * @param[in] sorted - latencies in increasing order
+ * @param[in] p - the percentile wanted, 0 to 1
+ *
+ * @returns the latency at that percentile
+ *
+ *****************************************************************************/
+uint64_t percentile ( const vector<uint64_t> &sorted, double p )
+{
+    size_t index = ( size_t ) ( p * ( sorted.size() - 1 ) );
+
+    return sorted[index];
+}
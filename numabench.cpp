@@ -0,0 +1,412 @@
+/**************************************************************************//**
+ * @file
+ * @brief Entry point for the parallel counting benchmark
+ *
+ * @details
+ * The benchmark loads a corpus into memory once and counts it again and
+ * again: first with a single WordCounter, then with a ParallelCounter for
+ * each thread count asked for, with threads kept on their NUMA nodes and
+ * then left to the scheduler. Every run is checked against the single
+ * threaded counts.
+ *
+ * For each run the throughput and the share of remote page allocations are
+ * displayed. Remote allocations are pages the kernel had to give a thread
+ * from a node other than its own; they are read from the per node numastat
+ * counters in sysfs, which cover the whole machine, so the figure is only
+ * meaningful on an otherwise quiet host. On a machine with a single node
+ * there is nothing remote and the pinned runs are skipped.
+ *
+ * @par Usage:
+ @verbatim
+ numabench corpus.txt [--threads=N,N,...] [--repeat=N]
+ corpus.txt - text to count, may be gzip or zstd
+ --threads - thread counts to try (1,2,4,8)
+ --repeat - runs of each kind, the fastest is kept (3)
+ @endverbatim
+ *
+ *****************************************************************************/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+
+#include "inputfile.h"
+#include "wordcounter.h"
+#include "parallelcounter.h"
+
+using namespace std;
+
+
+
+/*!
+ * @brief Result of counting the corpus one way
+ */
+struct benchRun
+{
+    double seconds;     /*!< Fastest time */
+    double remote;      /*!< Share of page allocations from a remote node */
+    bool correct;       /*!< If every run matched the single threaded counts */
+};
+
+
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+bool readNumaStat ( uint64_t &local, uint64_t &remote );
+benchRun runSerial ( const string &text, int repeat, WordCounter &expected );
+benchRun runParallel ( const string &text, int repeat, unsigned threads,
+                       bool pin, WordCounter &expected );
+bool sameCounts ( WordCounter &l, WordCounter &r );
+void printRun ( const string &name, const string &placement, benchRun run,
+                double bytes, double serial );
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This is the starting point for the benchmark. The arguments are read and
+ * the corpus is loaded. The single threaded run is timed first; it gives
+ * the counts the other runs are checked against and the speed they are
+ * compared to.
+ *
+ * @param[in] argc - count of arguments in argv
+ * @param[in] argv - array of arguments read from the command line
+ *
+ * @return 0 - every run matched
+ * @return 1 - invalid arguments present
+ * @return 2 - the corpus could not be read
+ * @return 3 - a parallel run counted differently
+ *****************************************************************************/
+int main ( int argc, char **argv )
+{
+    const char *path = nullptr;     //Corpus to count
+    vector<unsigned> threads = { 1, 2, 4, 8 }; //Thread counts to try
+    int repeat = 3;                 //Runs of each kind
+    string arg;                     //Argument being looked at
+    InputFile fin;                  //The corpus
+    ostringstream loaded;           //The corpus, read into memory
+    string text;
+    WordCounter expected;           //Single threaded counts
+    benchRun serial;
+    benchRun run;
+    bool correct = true;
+
+
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        arg = argv[i];
+
+        if ( arg.compare ( 0, 10, "--threads=" ) == 0 )
+        {
+            istringstream list ( arg.substr ( 10 ) );
+            string count;
+
+            threads.clear();
+
+            while ( getline ( list, count, ',' ) )
+            {
+                threads.push_back ( ( unsigned ) atoi ( count.c_str() ) );
+            }
+        }
+        else if ( arg.compare ( 0, 9, "--repeat=" ) == 0 )
+        {
+            repeat = atoi ( arg.c_str() + 9 );
+        }
+        else if ( path == nullptr && arg.compare ( 0, 2, "--" ) != 0 )
+        {
+            path = argv[i];
+        }
+        else
+        {
+            path = nullptr;
+            break;
+        }
+    }
+
+    if ( path == nullptr || repeat < 1 || threads.empty() )
+    {
+        cout << "Error, invalid arguments!" << endl;
+        cout << "Usage: " << argv[0] << " corpus.txt [--threads=N,N,...] "
+             << "[--repeat=N]" << endl;
+        return 1;
+    }
+
+    fin.open ( path );
+    loaded << fin.rdbuf();
+
+    if ( !fin || fin.bad() )
+    {
+        cout << "Error, the corpus could not be read!" << endl;
+        return 2;
+    }
+
+    text = loaded.str();
+
+
+
+    serial = runSerial ( text, repeat, expected );
+
+    cout << "corpus:  " << text.size() << " bytes, " << expected.totalWords()
+         << " words, " << expected.distinctWords() << " distinct" << endl;
+    cout << "nodes:   " << findNumaNodes().size() << endl << endl;
+    cout << left << setw ( 9 ) << "threads" << setw ( 11 ) << "placement"
+         << right << setw ( 10 ) << "seconds" << setw ( 10 ) << "MB/s"
+         << setw ( 9 ) << "speedup" << setw ( 9 ) << "remote" << endl;
+
+    printRun ( "serial", "-", serial, ( double ) text.size(), serial.seconds );
+
+    for ( unsigned count : threads )
+    {
+        if ( count < 1 )
+        {
+            continue;
+        }
+
+        //Pinning only does something with more than one node
+        if ( ParallelCounter ( count ).pinned() )
+        {
+            run = runParallel ( text, repeat, count, true, expected );
+            printRun ( to_string ( count ), "pinned", run, ( double ) text.size(),
+                       serial.seconds );
+            correct = correct && run.correct;
+        }
+
+        run = runParallel ( text, repeat, count, false, expected );
+        printRun ( to_string ( count ), "scheduler", run, ( double ) text.size(),
+                   serial.seconds );
+        correct = correct && run.correct;
+    }
+
+    if ( !correct )
+    {
+        cout << "Error, a parallel run counted differently!" << endl;
+        return 3;
+    }
+
+    return 0;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function adds up the page allocation counters of every node: pages
+ * given to a thread running on the same node, and pages given to a thread
+ * running on another node.
+ *
+ * @param[out] local - pages allocated on the requesting thread's node
+ * @param[out] remote - pages allocated on another node
+ *
+ * @returns true - the counters were read
+ * @returns false - the system has no per node counters
+ *
+ *****************************************************************************/
+bool readNumaStat ( uint64_t &local, uint64_t &remote )
+{
+    ifstream stat;
+    string name;
+    uint64_t value;
+    bool found = false;
+
+    local = 0;
+    remote = 0;
+
+    for ( int node = 0; ; node++ )
+    {
+        stat.open ( "/sys/devices/system/node/node" + to_string ( node ) +
+                    "/numastat" );
+
+        if ( !stat )
+        {
+            return found;
+        }
+
+        while ( stat >> name >> value )
+        {
+            if ( name == "local_node" )
+            {
+                local += value;
+            }
+            else if ( name == "other_node" )
+            {
+                remote += value;
+            }
+        }
+
+        stat.close();
+        stat.clear();
+        found = true;
+    }
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function times counting the corpus with a single WordCounter.
+ *
+ * @param[in]  text - the corpus
+ * @param[in]  repeat - number of runs
+ * @param[out] expected - the counts
+ *
+ * @returns the fastest run
+ *
+ *****************************************************************************/
+benchRun runSerial ( const string &text, int repeat, WordCounter &expected )
+{
+    benchRun run = { 0, -1, true };
+
+    for ( int i = 0; i < repeat; i++ )
+    {
+        istringstream in ( text );
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        expected.clear();
+        expected.ingest ( in );
+
+        double seconds = chrono::duration<double> ( chrono::steady_clock::now()
+                         - start ).count();
+
+        run.seconds = i == 0 ? seconds : min ( run.seconds, seconds );
+    }
+
+    return run;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function times counting the corpus with a ParallelCounter and checks
+ * each run against the single threaded counts. The remote allocation share
+ * covers every run.
+ *
+ * @param[in] text - the corpus
+ * @param[in] repeat - number of runs
+ * @param[in] threads - number of counting threads
+ * @param[in] pin - if threads are kept on their node
+ * @param[in] expected - the single threaded counts
+ *
+ * @returns the fastest run
+ *
+ *****************************************************************************/
+benchRun runParallel ( const string &text, int repeat, unsigned threads,
+                       bool pin, WordCounter &expected )
+{
+    benchRun run = { 0, -1, true };
+    uint64_t localBefore = 0;
+    uint64_t remoteBefore = 0;
+    uint64_t local = 0;
+    uint64_t remote = 0;
+    bool stat = readNumaStat ( localBefore, remoteBefore );
+
+    for ( int i = 0; i < repeat; i++ )
+    {
+        istringstream in ( text );
+        WordCounter result;
+        ParallelCounter counter ( threads );
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        counter.setPinning ( pin );
+
+        if ( !counter.count ( in, result ) )
+        {
+            run.correct = false;
+        }
+
+        double seconds = chrono::duration<double> ( chrono::steady_clock::now()
+                         - start ).count();
+
+        run.seconds = i == 0 ? seconds : min ( run.seconds, seconds );
+        run.correct = run.correct && sameCounts ( result, expected );
+    }
+
+    if ( stat && readNumaStat ( local, remote ) &&
+            local + remote > localBefore + remoteBefore )
+    {
+        run.remote = ( double ) ( remote - remoteBefore ) /
+                     ( double ) ( local + remote - localBefore - remoteBefore );
+    }
+
+    return run;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function checks that two counters hold the same words with the same
+ * counts.
+ *
+ * @param[in] l - one counter
+ * @param[in] r - the other counter
+ *
+ * @returns true - the counts are the same
+ * @returns false - the counts differ
+ *
+ *****************************************************************************/
+bool sameCounts ( WordCounter &l, WordCounter &r )
+{
+    bool same = l.distinctWords() == r.distinctWords() &&
+                l.totalWords() == r.totalWords();
+
+    l.forEachByFrequency ( [&] ( string_view word, uint64_t count )
+    {
+        same = same && r.count ( word ) == count;
+        return same;
+    } );
+
+    return same;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function displays one line of the results table.
+ *
+ * @param[in] name - thread count, or serial
+ * @param[in] placement - how threads were placed
+ * @param[in] run - the run
+ * @param[in] bytes - size of the corpus
+ * @param[in] serial - seconds taken by the single threaded run
+ *
+ *****************************************************************************/
+void printRun ( const string &name, const string &placement, benchRun run,
+                double bytes, double serial )
+{
+    cout << left << setw ( 9 ) << name << setw ( 11 ) << placement << right
+         << fixed << setprecision ( 3 ) << setw ( 10 ) << run.seconds
+         << setprecision ( 1 ) << setw ( 10 ) << bytes / run.seconds / 1e6
+         << setprecision ( 2 ) << setw ( 9 ) << serial / run.seconds;
+
+    if ( run.remote < 0 )
+    {
+        cout << setw ( 9 ) << "-";
+    }
+    else
+    {
+        cout << setprecision ( 1 ) << setw ( 8 ) << run.remote * 100 << "%";
+    }
+
+    cout << ( run.correct ? "" : "  MISMATCH" ) << endl;
+}
@@ -0,0 +1,304 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Implementation of the command line parsing shared by the programs
+*
+******************************************************************************/
+#include "options.h"
+
+#include <charconv>
+#include <cstdint>
+#include <thread>
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads the command line into an options structure. Options
+ * start with "--" and may appear anywhere; the remaining arguments are one
+ * or more input files followed by the output file. A memory limit is not
+ * used with --dedup or --variants, and a checkpoint with none of those.
+ *
+ * @param[in]  argc - count of arguments in argv
+ * @param[in]  argv - array of arguments read from the command line
+ * @param[out] opts - the settings that were read
+ *
+ * @returns true - the command line was valid
+ * @returns false - an option was unknown or a file was missing
+ *
+ *****************************************************************************/
+bool parseOptions ( int argc, char **argv, options &opts )
+{
+    int files = 0;      //Number of file arguments seen
+    string arg;         //Argument being looked at
+
+
+
+    opts = options();
+    opts.stopWords = false;
+    opts.backend = LIST_BACKEND;
+    opts.format = COLUMNS_FORMAT;
+    opts.threads = 1;
+    opts.dedup = NO_DEDUP;
+    opts.maxMemory = 0;
+    opts.checkpointSeconds = 60;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        arg = argv[i];
+
+        if ( arg == "--stopwords" )
+        {
+            opts.stopWords = true;
+        }
+        else if ( arg.compare ( 0, 12, "--stopwords=" ) == 0 )
+        {
+            opts.stopWords = true;
+            opts.stopFile = arg.substr ( 12 );
+
+            if ( opts.stopFile.empty() )
+            {
+                return false;
+            }
+        }
+        else if ( arg == "--backend=list" )
+        {
+            opts.backend = LIST_BACKEND;
+        }
+        else if ( arg == "--backend=hash" )
+        {
+            opts.backend = HASH_BACKEND;
+        }
+        else if ( arg.compare ( 0, 9, "--format=" ) == 0 )
+        {
+            if ( !parseFormat ( arg.substr ( 9 ), opts.format ) )
+            {
+                return false;
+            }
+        }
+        else if ( arg.compare ( 0, 10, "--threads=" ) == 0 )
+        {
+            if ( !parseCount ( string_view ( arg ).substr ( 10 ), opts.threads,
+                               max ( 1u, thread::hardware_concurrency() ) * 4 ) )
+            {
+                return false;
+            }
+        }
+        else if ( arg.compare ( 0, 8, "--dedup=" ) == 0 )
+        {
+            if ( !parseDedup ( arg.substr ( 8 ), opts.dedup ) )
+            {
+                return false;
+            }
+        }
+        else if ( arg.compare ( 0, 13, "--max-memory=" ) == 0 )
+        {
+            if ( !parseSize ( string_view ( arg ).substr ( 13 ),
+                              opts.maxMemory ) || opts.maxMemory < ( 1 << 20 ) )
+            {
+                return false;
+            }
+        }
+        else if ( arg.compare ( 0, 11, "--variants=" ) == 0 )
+        {
+            opts.variantFile = arg.substr ( 11 );
+
+            if ( opts.variantFile.empty() )
+            {
+                return false;
+            }
+        }
+        else if ( arg.compare ( 0, 13, "--checkpoint=" ) == 0 )
+        {
+            opts.checkpoint = arg.substr ( 13 );
+
+            if ( opts.checkpoint.empty() )
+            {
+                return false;
+            }
+        }
+        else if ( arg.compare ( 0, 19, "--checkpoint-every=" ) == 0 )
+        {
+            //At most a week apart
+            if ( !parseCount ( string_view ( arg ).substr ( 19 ),
+                               opts.checkpointSeconds, 7 * 24 * 60 * 60 ) )
+            {
+                return false;
+            }
+        }
+        else if ( arg.compare ( 0, 2, "--" ) == 0 )
+        {
+            //Unknown option
+            return false;
+        }
+        else
+        {
+            //Inputs first, the last file is the output
+            opts.inputs.push_back ( arg );
+            files++;
+        }
+    }
+
+    if ( files < 2 || ( opts.maxMemory != 0 &&
+                        ( opts.dedup != NO_DEDUP || !opts.variantFile.empty() ) ) )
+    {
+        return false;
+    }
+
+    if ( !opts.checkpoint.empty() && ( opts.dedup != NO_DEDUP ||
+                                       opts.maxMemory != 0 ||
+                                       !opts.variantFile.empty() ) )
+    {
+        return false;
+    }
+
+    opts.output = opts.inputs.back();
+    opts.inputs.pop_back();
+
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function displays the usage statement.
+ *
+ * @param[out] out - where the function prints to
+ * @param[in]  program - name the program was run as
+ *
+ *****************************************************************************/
+void printUsage ( ostream &out, const char *program )
+{
+    out << "Usage: " << program << " [options] shortstory.txt... results.txt"
+        << endl;
+    out << "  --stopwords         leave common English words out" << endl;
+    out << "  --stopwords=FILE    leave the words listed in FILE out" << endl;
+    out << "  --backend=list      count with the sorted linked list (default)"
+        << endl;
+    out << "  --backend=hash      count with the hash table" << endl;
+    out << "  --format=FORMAT     write the results as columns (default), tsv,"
+        << endl;
+    out << "                      csv, ndjson or binary" << endl;
+    out << "  --threads=N         count (hash table only) and write the results"
+        << endl;
+    out << "                      with N threads, at most 4 per processor"
+        << endl;
+    out << "  --dedup=file        count repeated input files only once (hash"
+        << endl;
+    out << "                      table only)" << endl;
+    out << "  --dedup=chunk       count repeated 64 KiB chunks only once (hash"
+        << endl;
+    out << "                      table only)" << endl;
+    out << "  --max-memory=SIZE   count with the hash table in at most SIZE"
+        << endl;
+    out << "                      bytes (K, M or G suffix, at least 1M),"
+        << endl;
+    out << "                      pruning rare words once it is reached"
+        << endl;
+    out << "  --variants=FILE     also count each capitalization of each word"
+        << endl;
+    out << "                      with the hash table and write them to FILE"
+        << endl;
+    out << "  --checkpoint=FILE   count with the hash table on one thread,"
+        << endl;
+    out << "                      saving the counts to FILE as it goes and"
+        << endl;
+    out << "                      resuming from FILE if it was cut short"
+        << endl;
+    out << "  --checkpoint-every=SECONDS  time between saves (60)" << endl;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads a size in bytes, optionally followed by K, M or G for
+ * kibibytes, mebibytes or gibibytes.
+ *
+ * @param[in]  text - the size as written
+ * @param[out] bytes - the size in bytes
+ *
+ * @returns true - the size was valid
+ * @returns false - the size was empty, not a number or too large
+ *
+ *****************************************************************************/
+bool parseSize ( string_view text, size_t &bytes )
+{
+    const char *end = text.data() + text.size();
+    from_chars_result result = from_chars ( text.data(), end, bytes );
+    unsigned shift = 0;
+
+    if ( text.empty() || result.ec != errc() )
+    {
+        return false;
+    }
+
+    if ( result.ptr + 1 == end )
+    {
+        switch ( *result.ptr )
+        {
+            case 'K':
+            case 'k':
+                shift = 10;
+                break;
+
+            case 'M':
+            case 'm':
+                shift = 20;
+                break;
+
+            case 'G':
+            case 'g':
+                shift = 30;
+                break;
+
+            default:
+                return false;
+        }
+    }
+    else if ( result.ptr != end )
+    {
+        return false;
+    }
+
+    if ( bytes > ( SIZE_MAX >> shift ) )
+    {
+        return false;
+    }
+
+    bytes <<= shift;
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads a whole number from 1 up to a limit, written in
+ * decimal with nothing after it.
+ *
+ * @param[in]  text - the number as written
+ * @param[out] value - the number
+ * @param[in]  most - largest number accepted
+ *
+ * @returns true - the number was valid
+ * @returns false - the number was empty, not a number, 0 or over the limit
+ *
+ *****************************************************************************/
+bool parseCount ( string_view text, unsigned &value, unsigned most )
+{
+    const char *end = text.data() + text.size();
+    from_chars_result result = from_chars ( text.data(), end, value );
+
+    return !text.empty() && result.ec == errc() && result.ptr == end &&
+           value >= 1 && value <= most;
+}
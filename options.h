@@ -0,0 +1,63 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Definition of the command line options shared by the programs
+*
+******************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+#include "report.h"
+#include "dedup.h"
+
+using namespace std;
+
+#ifndef __OPTIONS_H
+#define __OPTIONS_H
+
+/*!
+ * @brief Structure used to count the words
+ */
+enum countBackend
+{
+    LIST_BACKEND,       /*!< The sorted linked list */
+    HASH_BACKEND        /*!< The WordCounter hash table */
+};
+
+
+
+/*!
+ * @brief Settings read from the command line
+ */
+struct options
+{
+    vector<string> inputs; /*!< Files the words are read from, in order */
+    string output;      /*!< File the results are written to */
+    bool stopWords;     /*!< If stop words are left out of the results */
+    string stopFile;    /*!< Stop word list to use, empty for the built in one */
+    countBackend backend; /*!< Structure used to count the words */
+    reportFormat format; /*!< Layout of the results file */
+    unsigned threads;   /*!< Threads writing the results file */
+    dedupMode dedup;    /*!< Repeated content counted only once */
+    size_t maxMemory;   /*!< Memory the counts may take, 0 for no limit */
+    string variantFile; /*!< File the variants of words are written to, empty
+                             for none */
+    string checkpoint;  /*!< Snapshot file for resuming, empty for none */
+    unsigned checkpointSeconds; /*!< Time between snapshots */
+};
+
+
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+bool parseOptions ( int argc, char **argv, options &opts );
+void printUsage ( ostream &out, const char *program );
+bool parseCount ( string_view text, unsigned &value, unsigned most );
+bool parseSize ( string_view text, size_t &bytes );
+
+#endif
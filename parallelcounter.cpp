@@ -0,0 +1,646 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Implementation of ParallelCounter class
+*
+* @details
+* The calling thread reads the stream in 4 MiB blocks, cut at white space so
+* no word is split, and deals them out to the NUMA nodes in turn. Every node
+* has its own arena of blocks allocated in its memory and a queue of filled
+* blocks, and its counting threads are kept on the node's processors with
+* local allocation, so each thread reads text from and counts into memory
+* on its own node. A thread counts into a shard of its own; there is no
+* sharing while counting.
+*
+* Merging is hierarchical. When a node runs out of text, the first thread
+* on the node merges the other shards of that node into its own, all in
+* local memory. The calling thread then merges one shard per node into the
+* result, the only step that crosses nodes.
+*
+* With libnuma (HAVE_NUMA defined, link -lnuma) the nodes come from the
+* kernel. Without it, or on a machine with a single node, there is one node
+* holding every processor and threads are left where the scheduler puts
+* them.
+*
+******************************************************************************/
+#include "parallelcounter.h"
+#include "tokenizer.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <latch>
+#include <deque>
+#include <memory>
+#include <span>
+#include <new>
+#include <cstring>
+#include <cstdlib>
+
+#ifdef HAVE_NUMA
+#include <numa.h>
+#endif
+
+
+
+/*!
+ * @brief Number of bytes of text in a block
+ */
+static const size_t BLOCK_SIZE = 1 << 22;
+
+/*!
+ * @brief Blocks in a node's arena for each thread on the node
+ */
+static const size_t BLOCKS_PER_THREAD = 2;
+
+
+
+/*!
+ * @brief A block of text cut at white space
+ */
+struct textBlock
+{
+    char *data;         /*!< The text, in the arena of a node */
+    size_t size;        /*!< Number of characters */
+};
+
+
+
+/*!
+ * @brief Everything belonging to one node while counting
+ */
+struct nodeWork
+{
+    const numaNode *node;   /*!< The node */
+    vector<char *> arena;   /*!< Every block allocated on the node */
+    vector<char *> unused;  /*!< Blocks waiting to be filled */
+    deque<textBlock> filled; /*!< Blocks waiting to be counted */
+    bool done = false;      /*!< If no more blocks will be filled */
+    mutex lock;             /*!< Guards unused, filled and done */
+    condition_variable changed; /*!< Signalled when those change */
+    vector<unique_ptr<WordCounter>> shards; /*!< Shard of each thread */
+    unique_ptr<latch> counted; /*!< Reached when every shard is counted */
+    bool failed = false;    /*!< If a thread on the node ran out of memory */
+};
+
+
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+void countOnNode ( nodeWork &work, size_t shard, StopWords *stop,
+                   bool variants, bool pin );
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates a counter that uses the given number of threads,
+ * kept on their nodes when the machine has more than one.
+ *
+ * @param[in] threads - number of counting threads, at least 1
+ *
+ ******************************************************************************/
+ParallelCounter::ParallelCounter ( unsigned threads )
+{
+    this->threads = threads < 1 ? 1 : threads;
+    stop = nullptr;
+    variants = false;
+    pin = true;
+    nodes = findNumaNodes();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function sets the words to leave out of the counts. The set is not
+ * copied and must outlive the counter.
+ *
+ * @param[in] stop - the stop words, nullptr to count everything
+ *
+ ******************************************************************************/
+void ParallelCounter::setStopWords ( StopWords *stop )
+{
+    this->stop = stop;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function makes the shards count the variants of words too, so they
+ * reach the result when the shards are merged. The result should count
+ * variants as well.
+ *
+ * @param[in] track - true to count the variants
+ *
+ ******************************************************************************/
+void ParallelCounter::setVariants ( bool track )
+{
+    variants = track;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function turns keeping threads and their memory on their node on or
+ * off. It is on by default; turning it off is mostly useful for measuring
+ * what it is worth.
+ *
+ * @param[in] pin - if threads should be kept on their node
+ *
+ ******************************************************************************/
+void ParallelCounter::setPinning ( bool pin )
+{
+    this->pin = pin;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function counts every word read from a stream and adds the counts to
+ * result. The counts come out exactly as if result had read the stream
+ * itself.
+ *
+ * @param[in,out] in - the stream to read
+ * @param[in,out] result - where the counts are added
+ *
+ * @returns true - the stream was read to the end and counted
+ * @returns false - the stream went bad or memory ran out
+ *
+ ******************************************************************************/
+bool ParallelCounter::count ( istream &in, WordCounter &result )
+{
+    vector<unique_ptr<nodeWork>> work;  //One per node that gets threads
+    vector<thread> workers;
+    WordCounter oversize;   //Words too long for a block
+    string carry;           //Unfinished word at the end of the last block
+    size_t next = 0;        //Node that gets the next block
+    size_t filled = 0;
+    size_t cut = 0;
+    char *block = nullptr;
+    char c = 0;
+    bool end = false;
+    bool ok = true;
+
+    oversize.setStopWords ( stop );
+    oversize.setVariants ( variants );
+
+    //Deal the threads out to the nodes, then give each node its arena
+    for ( size_t n = 0; n < nodes.size() && n < threads; n++ )
+    {
+        work.push_back ( make_unique<nodeWork>() );
+        work.back()->node = &nodes[n];
+    }
+
+    for ( unsigned t = 0; t < threads; t++ )
+    {
+        work[t % work.size()]->shards.emplace_back();
+    }
+
+    for ( unique_ptr<nodeWork> &node : work )
+    {
+        node->counted = make_unique<latch> ( node->shards.size() );
+
+        for ( size_t i = 0; i < node->shards.size() * BLOCKS_PER_THREAD; i++ )
+        {
+            block = ( char * ) allocOnNode ( BLOCK_SIZE, node->node->id );
+
+            if ( block == nullptr )
+            {
+                ok = false;
+                break;
+            }
+
+            node->arena.push_back ( block );
+            node->unused.push_back ( block );
+        }
+    }
+
+    for ( size_t n = 0; ok && n < work.size(); n++ )
+    {
+        for ( size_t s = 0; s < work[n]->shards.size(); s++ )
+        {
+            workers.emplace_back ( countOnNode, ref ( *work[n] ), s, stop,
+                                   variants, pinned() );
+        }
+    }
+
+
+
+    //Fill blocks and hand them to the nodes in turn
+    while ( ok && !end )
+    {
+        nodeWork &node = *work[next];
+
+        {
+            unique_lock<mutex> hold ( node.lock );
+
+            node.changed.wait ( hold, [&] { return !node.unused.empty(); } );
+            block = node.unused.back();
+            node.unused.pop_back();
+        }
+
+        memcpy ( block, carry.data(), carry.size() );
+        in.read ( block + carry.size(), BLOCK_SIZE - carry.size() );
+        filled = carry.size() + ( size_t ) in.gcount();
+        end = !in;
+
+        //Back up to the white space before the last word
+        cut = filled;
+
+        while ( !end && cut > 0 && !isSeparator ( block[cut - 1] ) )
+        {
+            cut--;
+        }
+
+        if ( cut == 0 && !end )
+        {
+            //One word fills the whole block, finish it here
+            carry.assign ( block, filled );
+
+            while ( in.get ( c ) && !isSeparator ( c ) )
+            {
+                carry.push_back ( c );
+            }
+
+            oversize.ingest ( span<const char> ( carry.data(), carry.size() ) );
+            carry.clear();
+            end = !in;
+        }
+        else
+        {
+            carry.assign ( block + cut, filled - cut );
+        }
+
+        {
+            lock_guard<mutex> hold ( node.lock );
+
+            if ( cut == 0 )
+            {
+                node.unused.push_back ( block );
+            }
+            else
+            {
+                node.filled.push_back ( { block, cut } );
+            }
+        }
+
+        node.changed.notify_all();
+        next = ( next + 1 ) % work.size();
+    }
+
+    for ( unique_ptr<nodeWork> &node : work )
+    {
+        {
+            lock_guard<mutex> hold ( node->lock );
+            node->done = true;
+        }
+
+        node->changed.notify_all();
+    }
+
+    for ( thread &worker : workers )
+    {
+        worker.join();
+    }
+
+
+
+    //Merge across nodes; each node's shards are already merged into its first
+    for ( unique_ptr<nodeWork> &node : work )
+    {
+        ok = ok && !node->failed;
+
+        if ( ok && !node->shards.empty() && node->shards[0] != nullptr )
+        {
+            result.merge ( *node->shards[0] );
+        }
+
+        node->shards.clear();
+
+        for ( char *used : node->arena )
+        {
+            freeOnNode ( used, BLOCK_SIZE );
+        }
+    }
+
+    if ( ok )
+    {
+        result.merge ( oversize );
+    }
+
+    return ok && !in.bad();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the number of NUMA nodes threads are spread over.
+ *
+ * @returns the number of nodes, 1 without NUMA support
+ *
+ ******************************************************************************/
+size_t ParallelCounter::nodeCount()
+{
+    return nodes.size();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function tells if threads will be kept on their node. That takes
+ * NUMA support, more than one node, and pinning left on.
+ *
+ * @returns true - threads and their memory stay on their node
+ * @returns false - threads go where the scheduler puts them
+ *
+ ******************************************************************************/
+bool ParallelCounter::pinned()
+{
+#ifdef HAVE_NUMA
+    return pin && nodes.size() > 1;
+#else
+    return false;
+#endif
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function is run by each counting thread. The thread moves to its
+ * node, creates its shard there and counts the node's blocks until there
+ * are no more. The last thread on the node to finish lets the first one
+ * know, and the first thread merges the node's other shards into its own.
+ *
+ * @param[in,out] work - the node's blocks and shards
+ * @param[in]     shard - which of the node's shards belongs to the thread
+ * @param[in]     stop - the stop words, may be nullptr
+ * @param[in]     variants - if the variants of words are counted
+ * @param[in]     pin - if the thread should move to its node
+ *
+ ******************************************************************************/
+void countOnNode ( nodeWork &work, size_t shard, StopWords *stop,
+                   bool variants, bool pin )
+{
+    unique_ptr<WordCounter> counter;
+    textBlock block;
+    bool failed = false;
+
+    if ( pin )
+    {
+        runOnNode ( *work.node );
+    }
+
+    //Created after moving so its memory is on the node
+    try
+    {
+        counter = make_unique<WordCounter>();
+        counter->setStopWords ( stop );
+        counter->setVariants ( variants );
+    }
+    catch ( bad_alloc & )
+    {
+        failed = true;
+    }
+
+    while ( true )
+    {
+        {
+            unique_lock<mutex> hold ( work.lock );
+
+            work.changed.wait ( hold, [&]
+            {
+                return !work.filled.empty() || work.done;
+            } );
+
+            if ( work.filled.empty() )
+            {
+                break;
+            }
+
+            block = work.filled.front();
+            work.filled.pop_front();
+        }
+
+        //Keep taking blocks after a failure so the reader never waits forever
+        try
+        {
+            if ( !failed )
+            {
+                counter->ingest ( span<const char> ( block.data, block.size ) );
+            }
+        }
+        catch ( bad_alloc & )
+        {
+            failed = true;
+        }
+
+        {
+            lock_guard<mutex> hold ( work.lock );
+            work.unused.push_back ( block.data );
+        }
+
+        work.changed.notify_all();
+    }
+
+    {
+        lock_guard<mutex> hold ( work.lock );
+
+        work.failed = work.failed || failed;
+        work.shards[shard] = failed ? nullptr : move ( counter );
+    }
+
+    work.counted->count_down();
+
+    if ( shard != 0 )
+    {
+        return;
+    }
+
+    //First merge, inside the node
+    work.counted->wait();
+
+    try
+    {
+        for ( size_t i = 1; i < work.shards.size() && !work.failed; i++ )
+        {
+            work.shards[0]->merge ( *work.shards[i] );
+            work.shards[i].reset();
+        }
+    }
+    catch ( bad_alloc & )
+    {
+        work.failed = true;
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function finds the NUMA nodes that have processors. Without NUMA
+ * support the whole machine is one node.
+ *
+ * @returns the nodes, at least one
+ *
+ ******************************************************************************/
+vector<numaNode> findNumaNodes()
+{
+    vector<numaNode> nodes;
+    unsigned cpus = thread::hardware_concurrency();
+
+#ifdef HAVE_NUMA
+    if ( numa_available() >= 0 )
+    {
+        bitmask *mask = numa_allocate_cpumask();
+
+        for ( int id = 0; id <= numa_max_node(); id++ )
+        {
+            numaNode node = { id, {} };
+
+            if ( numa_node_to_cpus ( id, mask ) != 0 )
+            {
+                continue;
+            }
+
+            for ( unsigned cpu = 0; cpu < mask->size; cpu++ )
+            {
+                if ( numa_bitmask_isbitset ( mask, cpu ) )
+                {
+                    node.cpus.push_back ( ( int ) cpu );
+                }
+            }
+
+            //Memory only nodes get no threads
+            if ( !node.cpus.empty() )
+            {
+                nodes.push_back ( node );
+            }
+        }
+
+        numa_free_cpumask ( mask );
+    }
+#endif
+
+    if ( nodes.empty() )
+    {
+        nodes.push_back ( { 0, {} } );
+
+        for ( unsigned cpu = 0; cpu < max ( cpus, 1u ); cpu++ )
+        {
+            nodes[0].cpus.push_back ( ( int ) cpu );
+        }
+    }
+
+    return nodes;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function keeps the calling thread on a node's processors and makes
+ * its new memory come from that node.
+ *
+ * @param[in] node - the node
+ *
+ * @returns true - the thread was moved
+ * @returns false - there is no NUMA support or the move failed
+ *
+ ******************************************************************************/
+bool runOnNode ( const numaNode &node )
+{
+#ifdef HAVE_NUMA
+    if ( numa_available() < 0 || numa_run_on_node ( node.id ) != 0 )
+    {
+        return false;
+    }
+
+    numa_set_localalloc();
+    return true;
+#else
+    ( void ) node;
+    return false;
+#endif
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function allocates memory on a node, or anywhere without NUMA
+ * support.
+ *
+ * @param[in] size - number of bytes
+ * @param[in] node - node the memory should be on
+ *
+ * @returns the memory, nullptr if it could not be allocated
+ *
+ ******************************************************************************/
+void *allocOnNode ( size_t size, int node )
+{
+#ifdef HAVE_NUMA
+    if ( numa_available() >= 0 )
+    {
+        return numa_alloc_onnode ( size, node );
+    }
+#endif
+
+    ( void ) node;
+    return malloc ( size );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function frees memory from allocOnNode.
+ *
+ * @param[in] block - the memory
+ * @param[in] size - number of bytes, as allocated
+ *
+ ******************************************************************************/
+void freeOnNode ( void *block, size_t size )
+{
+#ifdef HAVE_NUMA
+    if ( numa_available() >= 0 )
+    {
+        numa_free ( block, size );
+        return;
+    }
+#endif
+
+    ( void ) size;
+    free ( block );
+}
@@ -0,0 +1,68 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Definition of ParallelCounter class
+*
+******************************************************************************/
+
+#include <istream>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "wordcounter.h"
+#include "stopwords.h"
+
+using namespace std;
+
+#ifndef __PARALLELCOUNTER_H
+#define __PARALLELCOUNTER_H
+
+/*!
+ * @brief A NUMA node and the processors that belong to it
+ */
+struct numaNode
+{
+    int id;             /*!< Node number, as the kernel knows it */
+    vector<int> cpus;   /*!< Processors on the node */
+};
+
+
+
+/*!
+ * @brief counts the words read from a stream with several threads, each
+ * counting whole blocks of text into its own shard; the shards are then
+ * merged into one WordCounter
+ */
+class ParallelCounter
+{
+    public:
+        ParallelCounter ( unsigned threads );
+
+        void setStopWords ( StopWords *stop );
+        void setVariants ( bool track );
+        void setPinning ( bool pin );
+        bool count ( istream &in, WordCounter &result );
+
+        size_t nodeCount();
+        bool pinned();
+
+    private:
+        unsigned threads;       /*!< Number of counting threads */
+        StopWords *stop;        /*!< Words to leave out, may be nullptr */
+        bool variants;          /*!< If the variants of words are counted */
+        bool pin;               /*!< If threads should be kept on their node */
+        vector<numaNode> nodes; /*!< Nodes of the machine */
+};
+
+
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+vector<numaNode> findNumaNodes();
+bool runOnNode ( const numaNode &node );
+void *allocOnNode ( size_t size, int node );
+void freeOnNode ( void *block, size_t size );
+
+#endif
@@ -0,0 +1,160 @@
+#!/bin/bash
+#
+# Builds the Release, LTO and PGO configurations and compares them with
+# perf stat.
+#
+#   ./perfstat.sh [--runs=N] [--save=FILE] [--baseline=FILE]
+#                 [--tolerance=PERCENT] [--build=DIR] [configuration...]
+#
+#   --runs       times perf stat repeats each workload (5)
+#   --save       write the results to FILE as tab separated values
+#   --baseline   compare with results saved earlier; exits with 1 if any
+#                workload takes more cycles than the baseline allows
+#   --tolerance  percent more cycles allowed over the baseline (5)
+#   --build      where the configurations are built (_perf)
+#
+# Every configuration is built in its own directory from this source tree,
+# so runs are repeatable on any host with the same compiler. Each workload
+# is run on the corpus the build generates from BandB.txt, and the table
+# shows time, instructions per cycle, last level cache misses per reference
+# and branch misses per branch. Counters the host does not expose, as in
+# most virtual machines, are shown as -.
+#
+set -e
+
+source=$(cd "$(dirname "$0")" && pwd)
+runs=5
+save=
+baseline=
+tolerance=5
+build=_perf
+configurations=()
+
+for arg in "$@"; do
+    case $arg in
+        --runs=*) runs=${arg#*=} ;;
+        --save=*) save=${arg#*=} ;;
+        --baseline=*) baseline=${arg#*=} ;;
+        --tolerance=*) tolerance=${arg#*=} ;;
+        --build=*) build=${arg#*=} ;;
+        --*) echo "Unknown option $arg" >&2; exit 2 ;;
+        *) configurations+=("$arg") ;;
+    esac
+done
+
+if [ ${#configurations[@]} -eq 0 ]; then
+    configurations=(Release LTO PGO)
+fi
+
+if ! command -v perf > /dev/null; then
+    echo "perf was not found; install linux-perf or linux-tools" >&2
+    exit 2
+fi
+
+events=task-clock,cycles,instructions,cache-references,cache-misses
+events=$events,branches,branch-misses
+results=$(mktemp)
+trap 'rm -f "$results" "$results".*' EXIT
+
+
+
+#
+# Runs one workload under perf stat and appends a line to the results:
+# configuration, workload, then the mean of each event.
+#
+measure()
+{
+    local configuration=$1 workload=$2
+    shift 2
+
+    perf stat -x, -o "$results.stat" -r "$runs" -e "$events" -- \
+        "$@" > /dev/null
+
+    awk -F, -v c="$configuration" -v w="$workload" '
+        $3 != "" { value[$3] = ($1 ~ /^[0-9.]+$/) ? $1 : "-" }
+        END {
+            printf "%s\t%s", c, w
+            n = split("task-clock cycles instructions cache-references " \
+                      "cache-misses branches branch-misses", names, " ")
+            for ( i = 1; i <= n; i++ )
+            {
+                v = "-"
+                for ( e in value )
+                {
+                    if ( e == names[i] || index(e, names[i] ":") == 1 )
+                    {
+                        v = value[e]
+                    }
+                }
+                printf "\t%s", v
+            }
+            printf "\n"
+        }' "$results.stat" >> "$results"
+}
+
+
+
+for configuration in "${configurations[@]}"; do
+    dir=$build/$configuration
+
+    cmake -S "$source" -B "$dir" -DCMAKE_BUILD_TYPE="$configuration" \
+        > /dev/null
+    cmake --build "$dir" -j"$(nproc)" > /dev/null
+
+    corpus=$dir/corpus.txt
+    out=$dir/perfstat.out
+
+    measure "$configuration" hash "$dir/prog2" --backend=hash \
+        "$corpus" "$out"
+    measure "$configuration" tsv "$dir/prog2" --backend=hash --format=tsv \
+        --stopwords "$corpus" "$out"
+    measure "$configuration" list "$dir/prog2" "$source/BandB.txt" "$out"
+    measure "$configuration" stl "$dir/prog2stl" "$source/BandB.txt" "$out"
+done
+
+
+
+#
+# The table, and the comparison with the baseline
+#
+awk -F'\t' '
+    function ratio(a, b)
+    {
+        if ( a == "-" || b == "-" || b == 0 ) { return "-" }
+        return sprintf("%.2f", a / b)
+    }
+    function percent(a, b)
+    {
+        if ( a == "-" || b == "-" || b == 0 ) { return "-" }
+        return sprintf("%.2f%%", 100 * a / b)
+    }
+    BEGIN {
+        printf "%-9s %-6s %10s %6s %11s %11s\n", "config", "work", "msec",
+               "IPC", "LLC miss", "br miss"
+    }
+    {
+        printf "%-9s %-6s %10s %6s %11s %11s\n", $1, $2, $3,
+               ratio($5, $4), percent($7, $6), percent($9, $8)
+    }' "$results"
+
+if [ -n "$save" ]; then
+    cp "$results" "$save"
+fi
+
+if [ -n "$baseline" ]; then
+    #Cycles when the host counts them, task-clock otherwise
+    awk -F'\t' -v tolerance="$tolerance" '
+        NR == FNR { base[$1 "\t" $2] = ($4 != "-") ? $4 : $3; next }
+        ($1 "\t" $2) in base {
+            now = ($4 != "-") ? $4 : $3
+            change = 100 * (now - base[$1 "\t" $2]) / base[$1 "\t" $2]
+            printf "%-9s %-6s %+7.2f%% against the baseline\n", $1, $2,
+                   change
+            if ( change > tolerance ) { failed = 1 }
+        }
+        END { exit failed }' "$baseline" "$results" ||
+    {
+        echo "Slower than the baseline by more than $tolerance%" >&2
+        exit 1
+    }
+fi
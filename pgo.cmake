@@ -0,0 +1,26 @@
+#
+# Renames the profile written by the instrumented _train targets to match
+# the real targets' objects.
+#
+#   cmake -DPROFILE=dir -P pgo.cmake
+#
+# GCC names each profile file after the absolute path of its object file,
+# with every / turned into #, so the profile of
+# CMakeFiles/prog2_train.dir/prog2.cpp.o is used for
+# CMakeFiles/prog2.dir/prog2.cpp.o once _train is dropped from its name.
+#
+if ( NOT PROFILE )
+    message ( FATAL_ERROR "PROFILE must name the profile directory" )
+endif ()
+
+file ( GLOB trained "${PROFILE}/*.gcda" )
+
+if ( NOT trained )
+    message ( FATAL_ERROR "Training left no profile in ${PROFILE}" )
+endif ()
+
+foreach ( from ${trained} )
+    get_filename_component ( name ${from} NAME )
+    string ( REPLACE "_train.dir#" ".dir#" name ${name} )
+    file ( RENAME ${from} ${PROFILE}/${name} )
+endforeach ()
@@ -30,7 +30,9 @@
  * in, any punctuation will be removed from the beginning and the end and
  * the word will be converted to lowercase.  If it is the first occurence
  * of the word, it will be added to the list.  If the word is already in
- * the list, the frequency count will be incremented.
+ * the list, the frequency count will be incremented.  Stop words, when
+ * requested, are dropped right after they are prepared and never reach the
+ * list.
  *
  * Once all of the words are read in and counted, the results will be written
  * to another text file.
@@ -39,13 +41,50 @@
  * @section compile_section Compiling and Usage
  *
  * @par Compiling Instructions:
- *      None
+ *      Needs a C++20 compiler. The counting code is shared with the other
+ *      programs: inputfile.cpp, options.cpp, stopwords.cpp, tokenizer.cpp,
+ *      report.cpp, wordtable.cpp, wordcounter.cpp, parallelcounter.cpp,
+ *      dedup.cpp, checkpoint.cpp and linklist.cpp make up the word frequency
+ *      library. Define HAVE_ZLIB and HAVE_ZSTD and link zlib and libzstd to
+ *      read compressed input. Define HAVE_NUMA and link libnuma to keep
+ *      counting threads on their NUMA node. CMakeLists.txt builds everything
+ *      and finds the libraries, with Release, LTO and PGO build types; the PGO
+ *      build trains on a corpus made from BandB.txt. perfstat.sh compares the
+ *      three with perf stat, and difftest checks that every backend writes the
+ *      same report as the list:
+ *
+ *          cmake -S . -B build -DCMAKE_BUILD_TYPE=PGO
+ *          cmake --build build
+ *          ./perfstat.sh --save=baseline.tsv
+ *          build/difftest
  *
  * @par Usage:
    @verbatim
-   c:\> prog2.exe input.txt output.txt
-        input.txt - text file to be read from
+   c:\> prog2.exe [options] input.txt... output.txt
+        input.txt - text files to be read from, may be gzip or zstd
         output.txt - text file to be written to
+        --stopwords - leave common English words out
+        --stopwords=list.txt - leave the words in list.txt out
+        --backend=hash - count with the hash table instead of the list
+        --format=columns|tsv|csv|ndjson|binary - layout of output.txt
+        --threads=N - with --backend=hash count with N threads spread over
+                      the NUMA nodes; format and write output.txt with N
+                      threads, at most 4 per processor
+        --dedup=file|chunk - count input files or 64 KiB chunks that repeat
+                             only once, multiplied, with the hash table
+        --max-memory=SIZE - count with the hash table, on one thread, in
+                            at most SIZE bytes (such as 512M); rare words
+                            are pruned once it is reached
+        --variants=variants.txt - count with the hash table and also write
+                                  how often each word was capitalized each
+                                  way to variants.txt, as word, variant and
+                                  count separated by tabs
+        --checkpoint=counts.snap - count with the hash table on one thread,
+                                   saving the counts and how far they got
+                                   to counts.snap every minute, and pick up
+                                   from counts.snap if a run was cut short;
+                                   it is removed once output.txt is written
+        --checkpoint-every=SECONDS - time between saves instead of a minute
    @endverbatim
  *
  * @section todo_bugs_modification_section Todo, Bugs, and Modifications
@@ -58,13 +97,17 @@
 *
  *****************************************************************************/
 #include "linklist.h"
+#include "inputfile.h"
+#include "tokenizer.h"
+#include "options.h"
+#include "stopwords.h"
+#include "wordcounter.h"
+#include "parallelcounter.h"
+#include "dedup.h"
+#include "checkpoint.h"
 
-
-
-/******************************************************************************
- *                         Function Prototypes
- *****************************************************************************/
-bool prepareWord ( string &word );
+#include <fcntl.h>
+#include <unistd.h>
 
 
 
@@ -72,51 +115,85 @@ bool prepareWord ( string &word );
  * @authors Nicholas Wendt, Christian Fattig
  *
  * @par Description:
- * This is the starting point for the program. First, the number of arguments
- * is verified; an error message and usage statement are displayed if
- * incorrect and the funcion exits. Next, the function attempts to open the
- * input and output files. If either file failed to open, an error message is
- * displayed and the function exits. Each word is then read from the input
- * file, processed and added to the list if new they are not exclusively
- * punctuation characters. If already in the list, the frequency is
- * incremented. If during this time, an addition to the list fails, an error
- * is displayed and the function exits. The input file is closed, the list is
- * printed to the output file, and the output file is closed.
+ * This is the starting point for the program. First, the arguments are
+ * parsed; an error message and usage statement are displayed if they are
+ * invalid and the funcion exits. Next, the function attempts to open the
+ * input and output files and load the stop word list, if one was requested.
+ * If any of these failed, an error message is displayed and the function
+ * exits. Each word is then read from the input files in turn, processed and
+ * added to the list if new they are not exclusively punctuation characters or
+ * stop words. If already in the list, the frequency is incremented. With
+ * --backend=hash the words are counted in a WordCounter hash table instead.
+ * With --dedup the input files are fingerprinted first and repeated files or
+ * chunks are counted only once. With --max-memory the hash table prunes its
+ * rarest words whenever it would grow over the limit, and the report is
+ * written with counts that may be low by the error bound printed. With
+ * --variants every capitalization of a word is counted in the same pass and
+ * written to a second file after the report. With --checkpoint the counts are
+ * saved as the files are read, and a run that finds a snapshot of the same
+ * inputs starts from it. If during this time, an addition to the list or table
+ * fails, an error is displayed and the function exits. The input file is
+ * closed, the list is printed to the output file, and the output file is
+ * closed.
  *
  * @param[in] argc - count of arguments in argv
  * @param[in] argv - array of arguments read from the command line
  *
  * @return 0 - program ran successfully
- * @return 1 - incorrect number of arguments present
- * @return 2 - input and/or output file failed to open
+ * @return 1 - invalid arguments present
+ * @return 2 - input, output and/or stop word file failed to open
  * @return 3 - memory allocation error occured while adding to the list
+ * @return 4 - input file is corrupt and could not be decompressed
+ * @return 5 - the results could not be written with threads
  *****************************************************************************/
 int main ( int argc, char **argv )
 {
     LinkList list;  //List used to store the words and their counts
-    ifstream fin;   //Input file
+    WordCounter counter; //Hash table used instead of the list if asked
+    InputFile fin;  //Input file (plain, gzip or zstd)
     ofstream fout;  //Output file
+    ofstream vout;  //Variants file, if asked for
     string temp;    //Temporary location for words from the input file
+    options opts;   //Settings from the command line
+    StopWords stop; //Words left out of the results
+    int fd = -1;    //Output file when written by several threads
     
     
     
-    //If argument count is not 3
-    if ( argc != 3 )
+    //If the arguments are not valid
+    if ( !parseOptions ( argc, argv, opts ) )
     {
         //Display error and usage statement
-        cout << "Error, invalid number of arguments!" << endl;
-        cout << "Usage: C:\\> prog2.exe  shortstory.txt  results.txt" << endl;
+        cout << "Error, invalid arguments!" << endl;
+        printUsage ( cout, argv[0] );
         return 1;
     }
     
     
     
-    //Attempt to open the input and output files
-    fin.open ( argv[1] );
-    fout.open ( argv[2] );
+    //Attempt to open the input files and the output file
+    for ( const string &input : opts.inputs )
+    {
+        fin.open ( input.c_str() );
+        
+        if ( !fin )
+        {
+            break;
+        }
+        
+        fin.close();
+    }
+    
+    fout.open ( opts.output.c_str(), opts.format == BINARY_FORMAT ?
+                ios::out | ios::binary : ios::out );
+    
+    if ( !opts.variantFile.empty() )
+    {
+        vout.open ( opts.variantFile.c_str() );
+    }
     
     //Verify success
-    if ( !fin || !fout )
+    if ( !fin || !fout || ( !opts.variantFile.empty() && !vout ) )
     {
         //Display error message
         cout << "Error, one or more files did not open!" << endl;
@@ -124,104 +201,250 @@ int main ( int argc, char **argv )
         //Close the files (one may have opened)
         fin.close();
         fout.close();
+        vout.close();
         return 2;
     }
     
+    //Choose the stop word list, if any
+    if ( opts.stopWords && opts.stopFile.empty() )
+    {
+        stop.useBuiltIn();
+    }
+    else if ( opts.stopWords && !stop.load ( opts.stopFile.c_str() ) )
+    {
+        //Display error message
+        cout << "Error, stop word list did not load!" << endl;
+        
+        fout.close();
+        return 2;
+    }
+    
+    
+    
+    //Count the capitalizations with the hash table too if asked
+    if ( !opts.variantFile.empty() )
+    {
+        opts.backend = HASH_BACKEND;
+        counter.setVariants ( true );
+    }
+    
+    //Fingerprint the input files first and count repeats once if asked
+    if ( opts.dedup != NO_DEDUP )
+    {
+        DedupCounter dedup ( opts.dedup );
+        dedupStats stats;
+        
+        opts.backend = HASH_BACKEND;
+        counter.setStopWords ( &stop );
+        dedup.setStopWords ( &stop );
+        dedup.setVariants ( !opts.variantFile.empty() );
+        
+        try
+        {
+            if ( !dedup.count ( opts.inputs, counter ) )
+            {
+                //Display error message and exit
+                cout << "Error, input file could not be decompressed!" << endl;
+                fout.close();
+                return 4;
+            }
+        }
+        catch ( bad_alloc & )
+        {
+            //Display error message and exit
+            cout << "Memory allocation error, exiting" << endl;
+            return 3;
+        }
+        
+        stats = dedup.stats();
+        cout << "Deduplication: " << stats.documentsSkipped << " of "
+             << stats.documents << " documents and " << stats.chunksSkipped
+             << " of " << stats.chunks << " chunks skipped, pre-pass "
+             << stats.prepassSeconds << " s, saved about "
+             << stats.savedSeconds << " s" << endl;
+    }
     
+    //Count under a memory limit with the hash table, pruning rare words
+    if ( opts.maxMemory != 0 )
+    {
+        opts.backend = HASH_BACKEND;
+        counter.setMemoryLimit ( opts.maxMemory );
+    }
+    
+    //Count from and into the snapshot if asked
+    if ( !opts.checkpoint.empty() )
+    {
+        Checkpointer check ( opts.checkpoint, opts.checkpointSeconds );
+        checkpointStats stats;
+        
+        opts.backend = HASH_BACKEND;
+        counter.setStopWords ( &stop );
+        check.setSettings ( opts.stopWords ? "stopwords=" + opts.stopFile :
+                            "" );
+        
+        try
+        {
+            if ( !check.count ( opts.inputs, counter ) )
+            {
+                //Display error message and exit
+                cout << "Error, input file could not be decompressed!" << endl;
+                fout.close();
+                return 4;
+            }
+        }
+        catch ( bad_alloc & )
+        {
+            //Display error message and exit
+            cout << "Memory allocation error, exiting" << endl;
+            return 3;
+        }
+        
+        stats = check.stats();
+        
+        if ( stats.resumed )
+        {
+            cout << "Checkpoint: resumed in input " << stats.input + 1
+                 << " at byte " << stats.offset << ", loaded in "
+                 << stats.restoreSeconds << " s" << endl;
+        }
+        
+        cout << "Checkpoint: " << stats.snapshots << " snapshots saved in "
+             << stats.saveSeconds << " s, " << stats.failed << " failed"
+             << endl;
+    }
     
-    //Read until end of file
-    while ( fin >> temp )
+    //Count the input files one after the other
+    for ( size_t i = 0; opts.dedup == NO_DEDUP && opts.checkpoint.empty() &&
+            i < opts.inputs.size(); i++ )
     {
-        //Remove punctuation, convert to lower case; add if valid
-        if ( prepareWord ( temp ) )
+        fin.open ( opts.inputs[i].c_str() );
+        
+        //Count with the hash table if asked, the list otherwise
+        if ( opts.backend == HASH_BACKEND )
         {
-            //Add to the list if not present, increment frequency if present
-            if ( list.find ( temp ) )
+            counter.setStopWords ( &stop );
+            
+            try
+            {
+                //Count with one shard per thread when asked for threads
+                if ( opts.threads > 1 && opts.maxMemory == 0 )
+                {
+                    ParallelCounter parallel ( opts.threads );
+                    
+                    parallel.setStopWords ( &stop );
+                    parallel.setVariants ( !opts.variantFile.empty() );
+                    
+                    if ( !parallel.count ( fin, counter ) && !fin.bad() )
+                    {
+                        throw bad_alloc();
+                    }
+                }
+                else
+                {
+                    counter.ingest ( fin );
+                }
+            }
+            catch ( bad_alloc & )
             {
-                list.incrementFrequency ( temp );
+                //Display error message and exit
+                cout << "Memory allocation error, exiting" << endl;
+                return 3;
             }
-            else
+        }
+        else
+        {
+            //Read until end of file
+            while ( fin >> temp )
             {
-                //If the list insert fails
-                if ( !list.insert ( temp ) )
+                //Remove punctuation, convert to lower case; add if valid
+                //and not a stop word
+                if ( prepareWord ( temp ) && !stop.contains ( temp ) )
                 {
-                    //Display error message and exit
-                    cout << "Memory allocation error, exiting" << endl;
-                    return 3;
+                    //Add to the list if not present, increment frequency if
+                    //present. If the list increment or insert fails
+                    if ( list.find ( temp ) ?
+                            !list.incrementFrequency ( temp ) :
+                            !list.insert ( temp ) )
+                    {
+                        //Display error message and exit
+                        cout << "Memory allocation error, exiting" << endl;
+                        return 3;
+                    }
                 }
             }
         }
+        
+        //Stopped early on a corrupt compressed file
+        if ( fin.bad() )
+        {
+            //Display error message and exit
+            cout << "Error, input file could not be decompressed!" << endl;
+            fin.close();
+            fout.close();
+            return 4;
+        }
+        
+        //Done reading, close input file
+        fin.close();
     }
     
-    //Done reading, close input file
-    fin.close();
-    
-    
-    
-    //Print the list to the output file
-    list.print ( fout );
-    
-    //Close output file
-    fout.close();
-    
-    return 0;
-}
-
-
-
-/**************************************************************************//**
- * @author Nicholas Wendt
- *
- * @par Description:
- * This function removes the punctuation from the front and end of the given
- * word. The word is also converted to lower case. First, the function
- * traverses the word until the first and last non punctuation characters are
- * found. If the entire word is punctuation, false is returned. The word is
- * punctuation is removed and the word is converted to lower case.
- *
- * @param[in,out] word - word to be processed
- *
- * @returns true - the word is valid (should be added to the list)
- * @returns false - the word is all punctuation
- *
- *****************************************************************************/
-bool prepareWord ( string &word )
-{
-    int i = 0;                      //Start on first character
-    int end = word.length() - 1;    //End on last character
+    if ( counter.prunedWords() != 0 )
+    {
+        cout << "Memory limit reached: " << counter.prunedWords()
+             << " rare words pruned, counts may be low by up to "
+             << counter.errorBound() << endl;
+    }
     
     
     
-    //Find first non punct character
-    while ( i < end && ispunct ( ( unsigned char ) word[i] ) )
+    //Print the counts to the output file, in parallel straight to the file
+    //when more than one thread is asked for
+    if ( opts.threads > 1 )
     {
-        i++;
+        fout.close();
+        fd = open ( opts.output.c_str(), O_WRONLY | O_TRUNC );
+        
+        if ( fd < 0 || !( opts.backend == HASH_BACKEND ?
+                          counter.report ( fd, opts.format, opts.threads ) :
+                          list.print ( fd, opts.format, opts.threads ) ) )
+        {
+            //Display error message and exit
+            cout << "Error, results could not be written!" << endl;
+            
+            if ( fd >= 0 )
+            {
+                close ( fd );
+            }
+            
+            return 5;
+        }
+        
+        close ( fd );
     }
-    
-    //Find last non punct character
-    while ( end > -1 && ispunct ( ( unsigned char ) word[end] ) )
+    else if ( opts.backend == HASH_BACKEND )
     {
-        end--;
+        counter.report ( fout, opts.format );
     }
-    
-    //If whole word was punct
-    if ( i > end )
+    else
     {
-        //Whole word was punct
-        return false;
+        list.print ( fout, opts.format );
     }
     
+    //Close output file
+    fout.close();
     
+    //The counts are written, the snapshot is not needed any more
+    if ( !opts.checkpoint.empty() )
+    {
+        Checkpointer ( opts.checkpoint, 0 ).finish();
+    }
     
-    //Get substring without punct
-    word = word.substr ( i, end + 1 - i );
-    
-    //Convert to lower case
-    for ( i = 0; i < ( int ) word.length(); i++ )
+    //The capitalizations, from the same counts
+    if ( !opts.variantFile.empty() )
     {
-        word[i] = tolower ( word[i] );
+        counter.reportVariants ( vout );
+        vout.close();
     }
     
-    //Word is good
-    return true;
+    return 0;
 }
\ No newline at end of file
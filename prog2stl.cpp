@@ -30,7 +30,9 @@
  * in, any punctuation will be removed from the beginning and the end and
  * the word will be converted to lowercase.  If it is the first occurence
  * of the word, it will be added to the list.  If the word is already in
- * the list, the frequency count will be incremented.
+ * the list, the frequency count will be incremented.  Stop words, when
+ * requested, are dropped right after they are prepared and never reach the
+ * list.
  *
  * Once all of the words are read in and counted, the results will be written
  * to another text file.
@@ -39,13 +41,25 @@
  * @section compile_section Compiling and Usage
  *
  * @par Compiling Instructions:
- *      None
+ *      Needs a C++20 compiler. The counting code is shared with the other
+ *      programs: inputfile.cpp, options.cpp, stopwords.cpp, tokenizer.cpp,
+ *      report.cpp, wordtable.cpp, wordcounter.cpp, parallelcounter.cpp,
+ *      dedup.cpp and linklist.cpp make up the word frequency library. Define
+ *      HAVE_ZLIB and HAVE_ZSTD and link zlib and libzstd to read compressed
+ *      input. CMakeLists.txt builds everything, with Release, LTO and PGO
+ *      build types:
+ *
+ *          cmake -S . -B build -DCMAKE_BUILD_TYPE=PGO
+ *          cmake --build build
  *
  * @par Usage:
  @verbatim
- c:\> prog2.exe input.txt output.txt
- input.txt - text file to be read from
+ c:\> prog2.exe [options] input.txt output.txt
+ input.txt - text file to be read from, may be gzip or zstd
  output.txt - text file to be written to
+ --stopwords - leave common English words out
+ --stopwords=list.txt - leave the words in list.txt out
+ --format=columns|tsv|csv|ndjson|binary - layout of output.txt
  @endverbatim
  *
  * @section todo_bugs_modification_section Todo, Bugs, and Modifications
@@ -64,6 +78,10 @@
 #include <cctype>
 #include <list>
 #include <algorithm>
+#include "inputfile.h"
+#include "tokenizer.h"
+#include "options.h"
+#include "stopwords.h"
 
 using namespace std;
 
@@ -86,8 +104,10 @@ struct item
  *                         Function Prototypes
  *****************************************************************************/
 bool compare2Items ( item &l, item &r );
-bool prepareWord ( string &word );
 void printList ( ostream &out, list<item> list );
+void exportList ( ostream &out, std::list<item> &list, reportFormat format );
+bool checkOptions ( int argc, char **argv );
+void printStlUsage ( ostream &out, const char *program );
 
 
 
@@ -95,47 +115,63 @@ void printList ( ostream &out, list<item> list );
  * @authors Nicholas Wendt, Christian Fattig
  *
  * @par Description:
- * This is the starting point for the program. First, the number of arguments
- * is verified; an error message and usage statement are displayed if
- * incorrect and the funcion exits. Next, the function attempts to open the
- * input and output files. If either file failed to open, an error message is
- * displayed and the function exits. Each word is then read from the input
- * file, processed and added to the list if new they are not exclusively
- * punctuation characters. If already in the list, the frequency is
- * incremented. The input file is closed, the list is sorted and printed to the
- * output file, and the output file is closed.
+ * This is the starting point for the program. First, the arguments are
+ * parsed; an error message and usage statement are displayed if they are
+ * invalid, or ask for an option this version does not implement, and the
+ * funcion exits. Next, the function attempts to open the input and output
+ * files and load the stop word list, if one was requested. If any of these
+ * failed, an error message is displayed and the function exits. Each word is
+ * then read from the input file, processed and added to the list if new they
+ * are not exclusively punctuation characters or stop words. If already in the
+ * list, the frequency is incremented. The input file is closed, the list is
+ * sorted and printed to the output file, and the output file is closed.
  *
  * @param[in] argc - count of arguments in argv
  * @param[in] argv - array of arguments read from the command line
  *
  * @return 0 - program ran successfully
- * @return 1 - incorrect number of arguments present
- * @return 2 - input and/or output file failed to open
+ * @return 1 - invalid or unsupported arguments present
+ * @return 2 - input, output and/or stop word file failed to open
+ * @return 3 - input file is corrupt and could not be decompressed
  *****************************************************************************/
 int main ( int argc, char **argv )
 {
     list<item> list;    //List used to store the words and their counts
     std::list<item>::iterator it;   //Iterator for the item list
-    ifstream fin;       //Input file
+    InputFile fin;      //Input file (plain, gzip or zstd)
     ofstream fout;      //Output file
     item temp;          //Temporary location for words from the input file
+    options opts;       //Settings from the command line
+    StopWords stop;     //Words left out of the results
 
 
 
-    //If argument count is not 3
-    if ( argc != 3 )
+    //If the arguments are not valid, or not ones this version implements
+    if ( !checkOptions ( argc, argv ) || !parseOptions ( argc, argv, opts ) )
     {
         //Display error and usage statement
-        cout << "Error, invalid number of arguments!" << endl;
-        cout << "Usage: C:\\> prog2.exe  shortstory.txt  results.txt" << endl;
+        cout << "Error, invalid arguments!" << endl;
+        printStlUsage ( cout, argv[0] );
         return 1;
     }
     
 
 
-    //Attempt to open the input and output files
-    fin.open ( argv[1] );
-    fout.open ( argv[2] );
+    //Attempt to open the input files and the output file
+    for ( const string &input : opts.inputs )
+    {
+        fin.open ( input.c_str() );
+        
+        if ( !fin )
+        {
+            break;
+        }
+        
+        fin.close();
+    }
+    
+    fout.open ( opts.output.c_str(), opts.format == BINARY_FORMAT ?
+                ios::out | ios::binary : ios::out );
     
     //Verify success
     if ( !fin || !fout )
@@ -149,43 +185,82 @@ int main ( int argc, char **argv )
         return 2;
     }
     
+    //Choose the stop word list, if any
+    if ( opts.stopWords && opts.stopFile.empty() )
+    {
+        stop.useBuiltIn();
+    }
+    else if ( opts.stopWords && !stop.load ( opts.stopFile.c_str() ) )
+    {
+        //Display error message
+        cout << "Error, stop word list did not load!" << endl;
+        
+        fout.close();
+        return 2;
+    }
+    
 
 
-    //Read until end of file
-    while ( fin >> temp.word )
+    //Count the input files one after the other
+    for ( const string &input : opts.inputs )
     {
-        //Remove punctuation, convert to lower case; add if valid
-        if ( prepareWord ( temp.word ) )
+        fin.open ( input.c_str() );
+        
+        //Read until end of file
+        while ( fin >> temp.word )
         {
-            //Linear search until end is reached or word is found
-            it = find ( list.begin(), list.end(), temp );
-            
-            //Add to the list if not present, increment frequency if present
-            if ( it != list.end() )
+            //Remove punctuation, convert to lower case; add if valid and
+            //not a stop word
+            if ( prepareWord ( temp.word ) && !stop.contains ( temp.word ) )
             {
-                it->frequencyCount++;
-            }
-            else
-            {
-                //Set initial frequency
-                temp.frequencyCount = 1;
+                //Linear search until end is reached or word is found
+                it = find ( list.begin(), list.end(), temp );
                 
-                //Add to the end of the list (find is linear anyways)
-                list.insert ( it, temp );
+                //Add to the list if not present, increment frequency if
+                //present
+                if ( it != list.end() )
+                {
+                    it->frequencyCount++;
+                }
+                else
+                {
+                    //Set initial frequency
+                    temp.frequencyCount = 1;
+                    
+                    //Add to the end of the list (find is linear anyways)
+                    list.insert ( it, temp );
+                }
             }
         }
+        
+        //Stopped early on a corrupt compressed file
+        if ( fin.bad() )
+        {
+            //Display error message and exit
+            cout << "Error, input file could not be decompressed!" << endl;
+            fin.close();
+            fout.close();
+            return 3;
+        }
+        
+        //Done reading, close input file
+        fin.close();
     }
     
-    //Done reading, close input file
-    fin.close();
-    
 
 
     //Sort by frequency first, then alphabetically in each frequency group
     list.sort ( compare2Items );
     
-    //Print the list to the output file
-    printList ( fout, list );
+    //Print the list to the output file, or export it in another format
+    if ( opts.format == COLUMNS_FORMAT )
+    {
+        printList ( fout, list );
+    }
+    else
+    {
+        exportList ( fout, list, opts.format );
+    }
     
     //Close output file
     fout.close();
@@ -261,65 +336,6 @@ bool compare2Items ( item &l, item &r )
 
 
 
-/**************************************************************************//**
- * @author Nicholas Wendt
- *
- * @par Description:
- * This function removes the punctuation from the front and end of the given
- * word. The word is also converted to lower case. First, the function
- * traverses the word until the first and last non punctuation characters are
- * found. If the entire word is punctuation, false is returned. The word's
- * punctuation is removed and the word is converted to lower case.
- *
- * @param[in,out] word - word to be processed
- *
- * @returns true - the word is valid (should be added to the list)
- * @returns false - the word is all punctuation
- *
- *****************************************************************************/
-bool prepareWord ( string &word )
-{
-    int i = 0;                      //Start on first character
-    int end = word.length() - 1;    //End on last character
-    
-
-
-    //Find first non punct character
-    while ( i < end && ispunct ( ( unsigned char ) word[i] ) )
-    {
-        i++;
-    }
-    
-    //Find last non punct character
-    while ( end > -1 && ispunct ( ( unsigned char ) word[end] ) )
-    {
-        end--;
-    }
-    
-    //If whole word was punct
-    if ( i > end )
-    {
-        //Whole word was punct
-        return false;
-    }
-    
-
-
-    //Get substring without punct
-    word = word.substr ( i, end + 1 - i );
-    
-    //Convert to lower case
-    for ( i = 0; i < ( int ) word.length(); i++ )
-    {
-        word[i] = tolower ( word[i] );
-    }
-    
-    //Word is good
-    return true;
-}
-
-
-
 /**************************************************************************//**
  * @author Nicholas Wendt
  *
@@ -375,4 +391,101 @@ void printList ( ostream &out, list<item> list )
         //Toggle column
         column = column ? false : true;
     }
-}
\ No newline at end of file
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes the contents of a sorted list in one of the machine
+ * readable report formats. The list is traversed once and every word is
+ * handed to the report writer with its frequency.
+ *
+ * @param[out] out - output stream to write the list to
+ * @param[in]  list - pre-sorted list to be written
+ * @param[in]  format - layout of the report
+ *
+ *****************************************************************************/
+void exportList ( ostream &out, std::list<item> &list, reportFormat format )
+{
+    ReportWriter report ( out, format );
+    int frequency = 0;      //Current frequency "group"
+    
+    for ( item &x : list )
+    {
+        //Pass on the new frequency
+        if ( frequency != x.frequencyCount )
+        {
+            frequency = x.frequencyCount;
+            report.frequency ( frequency );
+        }
+        
+        report.word ( x.word );
+    }
+    
+    report.finish();
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function checks that the only options given are ones this version
+ * implements, --stopwords and --format. The other programs' options are
+ * refused rather than ignored, so the results are never different from what
+ * the command line asked for.
+ *
+ * @param[in] argc - count of arguments in argv
+ * @param[in] argv - array of arguments read from the command line
+ *
+ * @returns true - every option is implemented here
+ * @returns false - an option is not implemented here
+ *
+ *****************************************************************************/
+bool checkOptions ( int argc, char **argv )
+{
+    string arg;         //Argument being looked at
+    
+    
+    for ( int i = 1; i < argc; i++ )
+    {
+        arg = argv[i];
+        
+        if ( arg.compare ( 0, 2, "--" ) == 0 && arg != "--stopwords" &&
+                arg.compare ( 0, 12, "--stopwords=" ) != 0 &&
+                arg.compare ( 0, 9, "--format=" ) != 0 )
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function displays the usage statement, with only the options this
+ * version implements.
+ *
+ * @param[out] out - where the function prints to
+ * @param[in]  program - name the program was run as
+ *
+ *****************************************************************************/
+void printStlUsage ( ostream &out, const char *program )
+{
+    out << "Usage: " << program << " [options] shortstory.txt... results.txt"
+        << endl;
+    out << "  --stopwords         leave common English words out" << endl;
+    out << "  --stopwords=FILE    leave the words listed in FILE out" << endl;
+    out << "  --format=FORMAT     write the results as columns (default), tsv,"
+        << endl;
+    out << "                      csv, ndjson or binary" << endl;
+}
@@ -0,0 +1,851 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Implementation of ReportWriter class
+*
+* @details
+* The columns layout is the one LinkList::print has always produced: every
+* word is padded to 35 characters and a line ends after every second word.
+* The other formats write one record per word for other programs to read:
+* tab or comma separated lines (CSV quoted as in RFC 4180), newline
+* delimited JSON, or binary records of a 64 bit count, a 32 bit length and
+* the word's bytes, both numbers little endian. Callers feed it the
+* frequencies from highest to lowest and the words of each frequency in
+* alphabetical order.
+*
+* Everything is formatted directly into a fixed buffer, numbers included,
+* which is handed to the stream only when it fills, so no strings are built
+* along the way.
+*
+* A large report can also be written by several threads. The caller splits
+* its words into ranges, one per thread, and each thread formats its range
+* into its own list of memory blocks. A range may start part way through the
+* words of a frequency, in which case the range before it wrote the banner.
+* Only the first range writes the header and only the last one the trailer,
+* so the ranges put end to end are byte for byte the serial report. Each thread learns where its range
+* starts once the ranges before it are formatted, and writes its blocks
+* there with pwritev while later threads are still formatting.
+*
+******************************************************************************/
+#include "report.h"
+
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <future>
+#include <streambuf>
+#include <new>
+#include <cerrno>
+
+#include <sys/uio.h>
+#include <limits.h>
+
+
+
+/*!
+ * @brief Width of each word column
+ */
+static const size_t COLUMN_WIDTH = 35;
+
+/*!
+ * @brief Line of '=' above and below each frequency banner
+ */
+static const char RULE[] =
+    "==============================================================================="
+    "\n";
+
+/*!
+ * @brief Size of the memory blocks a report segment is formatted into
+ */
+static const size_t BLOCK_SIZE = 1 << 20;
+
+
+
+/*!
+ * @brief stream buffer that keeps everything written to it in a list of
+ * memory blocks, ready to be handed to pwritev
+ */
+class SegmentBuf : public streambuf
+{
+    public:
+        size_t size();
+        bool writeAt ( int fd, uint64_t offset );
+
+    protected:
+        streamsize xsputn ( const char *text, streamsize length ) override;
+        int_type overflow ( int_type c ) override;
+
+    private:
+        vector<unique_ptr<char[]>> blocks; /*!< Filled blocks, then the last */
+        size_t used = 0;        /*!< Bytes used in the last block */
+};
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates a writer for the given stream.
+ *
+ * @param[out] out - where the report is written
+ * @param[in]  format - layout of the report
+ * @param[in]  first - if the writer starts the report, false for a later
+ * segment of a report written in parts
+ *
+ ******************************************************************************/
+ReportWriter::ReportWriter ( ostream &out, reportFormat format, bool first ) :
+    out ( out )
+{
+    this->format = format;
+    count = 0;
+    column = 0;
+    used = 0;
+
+    //Separated values start with a header line
+    if ( !first )
+    {
+        return;
+    }
+
+    if ( format == TSV_FORMAT )
+    {
+        put ( "word\tcount\n", 11 );
+    }
+    else if ( format == CSV_FORMAT )
+    {
+        put ( "word,count\n", 11 );
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function starts the words for a new frequency. The columns layout
+ * displays the frequency header; the other formats write the frequency with
+ * each word. A segment that picks up part way through a frequency's words
+ * says how many were written before it, and gets no header.
+ *
+ * @param[in] count - the frequency the following words occur with
+ * @param[in] written - words of the frequency earlier segments wrote
+ *
+ ******************************************************************************/
+void ReportWriter::frequency ( uint64_t count, uint64_t written )
+{
+    this->count = count;
+    column = written;
+
+    if ( format != COLUMNS_FORMAT || written != 0 )
+    {
+        return;
+    }
+
+    put ( "\n\n", 2 );
+    put ( RULE, sizeof ( RULE ) - 1 );
+    put ( "          Frequency Count: ", 27 );
+    putNumber ( count );
+    putChar ( '\n' );
+    put ( RULE, sizeof ( RULE ) - 1 );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes a word in the report's format. In columns the word
+ * goes in the next column, padded to the column width, and a line is ended
+ * after every second word.
+ *
+ * @param[in] word - the word to write
+ *
+ ******************************************************************************/
+void ReportWriter::word ( string_view word )
+{
+    static const char SPACES[COLUMN_WIDTH + 1] =
+        "                                   ";
+
+    switch ( format )
+    {
+        case COLUMNS_FORMAT:
+            put ( word.data(), word.length() );
+
+            if ( word.length() < COLUMN_WIDTH )
+            {
+                put ( SPACES, COLUMN_WIDTH - word.length() );
+            }
+
+            column++;
+
+            //used for inserting endline after 2 words printed
+            if ( column % 2 == 0 )
+            {
+                putChar ( '\n' );
+            }
+
+            break;
+
+        case TSV_FORMAT:
+            //Words never hold tabs or newlines, they separate words
+            put ( word.data(), word.length() );
+            putChar ( '\t' );
+            putNumber ( count );
+            putChar ( '\n' );
+            break;
+
+        case CSV_FORMAT:
+            putQuoted ( word );
+            putChar ( ',' );
+            putNumber ( count );
+            putChar ( '\n' );
+            break;
+
+        case NDJSON_FORMAT:
+            put ( "{\"word\":\"", 9 );
+            putEscaped ( word );
+            put ( "\",\"count\":", 10 );
+            putNumber ( count );
+            put ( "}\n", 2 );
+            break;
+
+        case BINARY_FORMAT:
+            putLittle ( count, 8 );
+            putLittle ( word.length(), 4 );
+            put ( word.data(), word.length() );
+            break;
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function ends the report and writes out whatever is still buffered.
+ *
+ * @param[in] last - if the writer ends the report, false for an earlier
+ * segment of a report written in parts
+ *
+ ******************************************************************************/
+void ReportWriter::finish ( bool last )
+{
+    if ( last && format == COLUMNS_FORMAT )
+    {
+        put ( "\n\n", 2 );
+    }
+
+    flushBuffer();
+    out.flush();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function appends bytes to the buffer, writing the buffer out first if
+ * they do not fit. Blocks larger than the buffer go straight to the stream.
+ *
+ * @param[in] text - the bytes
+ * @param[in] length - number of bytes
+ *
+ ******************************************************************************/
+void ReportWriter::put ( const char *text, size_t length )
+{
+    if ( used + length > BUFFER_SIZE )
+    {
+        flushBuffer();
+
+        if ( length > BUFFER_SIZE )
+        {
+            out.write ( text, length );
+            return;
+        }
+    }
+
+    memcpy ( buffer + used, text, length );
+    used += length;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function appends one character to the buffer.
+ *
+ * @param[in] c - the character
+ *
+ ******************************************************************************/
+void ReportWriter::putChar ( char c )
+{
+    if ( used == BUFFER_SIZE )
+    {
+        flushBuffer();
+    }
+
+    buffer[used++] = c;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function appends a number in decimal.
+ *
+ * @param[in] number - the number
+ *
+ ******************************************************************************/
+void ReportWriter::putNumber ( uint64_t number )
+{
+    char digits[20];
+    char *end = to_chars ( digits, digits + sizeof ( digits ), number ).ptr;
+
+    put ( digits, end - digits );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function appends the low bytes of a number, least significant first,
+ * whatever the byte order of the machine.
+ *
+ * @param[in] number - the number
+ * @param[in] bytes - number of bytes to write, at most 8
+ *
+ ******************************************************************************/
+void ReportWriter::putLittle ( uint64_t number, size_t bytes )
+{
+    char packed[8];
+
+    for ( size_t i = 0; i < bytes; i++ )
+    {
+        packed[i] = ( char ) ( number >> ( 8 * i ) );
+    }
+
+    put ( packed, bytes );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function appends a CSV field. A word holding a comma or quote is
+ * wrapped in quotes with its own quotes doubled; others are written as is.
+ *
+ * @param[in] word - the word
+ *
+ ******************************************************************************/
+void ReportWriter::putQuoted ( string_view word )
+{
+    if ( word.find_first_of ( ",\"" ) == string_view::npos )
+    {
+        put ( word.data(), word.length() );
+        return;
+    }
+
+    putChar ( '"' );
+
+    for ( char c : word )
+    {
+        if ( c == '"' )
+        {
+            putChar ( '"' );
+        }
+
+        putChar ( c );
+    }
+
+    putChar ( '"' );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function appends a word as the inside of a JSON string, escaping
+ * quotes, backslashes and control characters. Valid UTF-8 is copied as it
+ * is, in runs; a byte that does not start a valid UTF-8 sequence is escaped
+ * as the code point of the same number, so text in Latin-1 still comes out
+ * as valid JSON.
+ *
+ * @param[in] word - the word
+ *
+ ******************************************************************************/
+void ReportWriter::putEscaped ( string_view word )
+{
+    static const char HEX[] = "0123456789abcdef";
+    size_t start = 0;
+    size_t length;
+    unsigned char c;
+
+    for ( size_t i = 0; i < word.length(); i++ )
+    {
+        c = ( unsigned char ) word[i];
+
+        if ( c != '"' && c != '\\' && c >= 0x20 && c < 0x80 )
+        {
+            continue;
+        }
+
+        //Skip over a whole valid sequence
+        if ( c >= 0x80 && ( length = utf8Length ( word, i ) ) != 0 )
+        {
+            i += length - 1;
+            continue;
+        }
+
+        put ( word.data() + start, i - start );
+        start = i + 1;
+
+        if ( c == '"' || c == '\\' )
+        {
+            putChar ( '\\' );
+            putChar ( ( char ) c );
+        }
+        else
+        {
+            put ( "\\u00", 4 );
+            putChar ( HEX[c >> 4] );
+            putChar ( HEX[c & 0xf] );
+        }
+    }
+
+    put ( word.data() + start, word.length() - start );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes the buffered bytes to the stream.
+ *
+ ******************************************************************************/
+void ReportWriter::flushBuffer()
+{
+    out.write ( buffer, used );
+    used = 0;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function looks up a report format by the name used on the command
+ * line: columns, tsv, csv, ndjson or binary.
+ *
+ * @param[in]  name - the format's name
+ * @param[out] format - the format, unchanged if the name is unknown
+ *
+ * @returns true - the name is a format
+ * @returns false - there is no format with that name
+ *
+ ******************************************************************************/
+bool parseFormat ( string_view name, reportFormat &format )
+{
+    static const struct
+    {
+        const char *name;
+        reportFormat format;
+    } FORMATS[] =
+    {
+        { "columns", COLUMNS_FORMAT },
+        { "tsv", TSV_FORMAT },
+        { "csv", CSV_FORMAT },
+        { "ndjson", NDJSON_FORMAT },
+        { "binary", BINARY_FORMAT }
+    };
+
+    for ( const auto &known : FORMATS )
+    {
+        if ( name == known.name )
+        {
+            format = known.format;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function checks for a valid UTF-8 sequence at a place in some text:
+ * the right number of continuation bytes, no overlong form, no surrogate and
+ * nothing past U+10FFFF.
+ *
+ * @param[in] text - the text
+ * @param[in] at - where the sequence starts
+ *
+ * @returns the length of the sequence, or 0 if it is not valid
+ *
+ ******************************************************************************/
+size_t utf8Length ( string_view text, size_t at )
+{
+    unsigned char lead = ( unsigned char ) text[at];
+    unsigned char low = 0x80;   //Range of the byte after the lead
+    unsigned char high = 0xbf;
+    size_t length;
+
+    if ( lead < 0x80 )
+    {
+        return 1;
+    }
+    else if ( lead >= 0xc2 && lead <= 0xdf )
+    {
+        length = 2;
+    }
+    else if ( lead >= 0xe0 && lead <= 0xef )
+    {
+        length = 3;
+        low = lead == 0xe0 ? 0xa0 : 0x80;
+        high = lead == 0xed ? 0x9f : 0xbf;
+    }
+    else if ( lead >= 0xf0 && lead <= 0xf4 )
+    {
+        length = 4;
+        low = lead == 0xf0 ? 0x90 : 0x80;
+        high = lead == 0xf4 ? 0x8f : 0xbf;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if ( text.length() - at < length ||
+            ( unsigned char ) text[at + 1] < low ||
+            ( unsigned char ) text[at + 1] > high )
+    {
+        return 0;
+    }
+
+    for ( size_t i = 2; i < length; i++ )
+    {
+        if ( ( ( unsigned char ) text[at + i] & 0xc0 ) != 0x80 )
+        {
+            return 0;
+        }
+    }
+
+    return length;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function splits a run of groups into contiguous ranges holding about
+ * the same number of items each. A group no larger than a range's share is
+ * kept whole, closing the range it fills, so fewer ranges than asked for
+ * may come back; a larger group is cut wherever a range fills up.
+ *
+ * @param[in] sizes - number of items in each group, in order
+ * @param[in] parts - number of ranges wanted
+ *
+ * @returns where each range starts, followed by { sizes.size(), 0 }; range i
+ * runs from bounds[i] up to bounds[i + 1]
+ *
+ ******************************************************************************/
+vector<reportPlace> splitRanges ( const vector<uint64_t> &sizes,
+                                  unsigned parts )
+{
+    vector<reportPlace> bounds ( 1, { 0, 0 } );
+    uint64_t total = 0;
+    uint64_t share;     //Items in each range
+    uint64_t room;      //Items the current range still takes
+    uint64_t item;      //Items of the group in earlier ranges
+
+    for ( uint64_t size : sizes )
+    {
+        total += size;
+    }
+
+    parts = parts == 0 ? 1 : parts;
+    share = max<uint64_t> ( 1, ( total + parts - 1 ) / parts );
+    room = share;
+
+    for ( size_t i = 0; i < sizes.size(); i++ )
+    {
+        item = 0;
+
+        //Cut a large group wherever a range fills up
+        while ( sizes[i] > share && sizes[i] - item > room &&
+                bounds.size() < parts )
+        {
+            item += room;
+            bounds.push_back ( { i, item } );
+            room = share;
+        }
+
+        //Close the range once it reaches its share of the items
+        if ( sizes[i] - item >= room )
+        {
+            if ( bounds.size() < parts && i + 1 < sizes.size() )
+            {
+                bounds.push_back ( { i + 1, 0 } );
+            }
+
+            room = share;
+        }
+        else
+        {
+            room -= sizes[i] - item;
+        }
+    }
+
+    bounds.push_back ( { sizes.size(), 0 } );
+
+    return bounds;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes a report in segments, one thread per segment. Each
+ * thread formats its segment into its own memory blocks, then waits for the
+ * segment before it to be formatted so it knows its offset in the file, and
+ * writes its blocks there with pwritev. The file ends up exactly as if the
+ * segments were written one after the other.
+ *
+ * @param[in] fd - file to write, from its start
+ * @param[in] segments - number of segments
+ * @param[in] format - called as format ( segment, out ) on a thread of its
+ * own to write one segment to out
+ *
+ * @returns true - every segment was written
+ * @returns false - memory ran out or a write failed
+ *
+ ******************************************************************************/
+bool writeSegments ( int fd, unsigned segments,
+                     const function<void ( unsigned, ostream & )> &format )
+{
+    vector<promise<uint64_t>> ends ( segments ); //End offset of each segment
+    vector<thread> threads;
+    vector<char> ok ( segments, 0 );
+
+    for ( unsigned i = 0; i < segments; i++ )
+    {
+        threads.emplace_back ( [&, i]
+        {
+            SegmentBuf buf;
+            ostream out ( &buf );
+            uint64_t start = 0;
+            bool formatted = true;
+
+            try
+            {
+                format ( i, out );
+            }
+            catch ( bad_alloc & )
+            {
+                formatted = false;
+            }
+
+            //Offsets are handed down the chain even after a failure
+            if ( i > 0 )
+            {
+                start = ends[i - 1].get_future().get();
+            }
+
+            ends[i].set_value ( start + buf.size() );
+            ok[i] = formatted && out && buf.writeAt ( fd, start );
+        } );
+    }
+
+    for ( thread &t : threads )
+    {
+        t.join();
+    }
+
+    for ( char done : ok )
+    {
+        if ( !done )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the number of bytes written to the buffer.
+ *
+ * @returns the size of the segment
+ *
+ ******************************************************************************/
+size_t SegmentBuf::size()
+{
+    if ( blocks.empty() )
+    {
+        return 0;
+    }
+
+    return ( blocks.size() - 1 ) * BLOCK_SIZE + used;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes the blocks to a file at the given offset, as many
+ * blocks per pwritev call as the system allows. A short write picks up
+ * where it stopped.
+ *
+ * @param[in] fd - the file
+ * @param[in] offset - where the segment starts in the file
+ *
+ * @returns true - the whole segment was written
+ * @returns false - a write failed
+ *
+ ******************************************************************************/
+bool SegmentBuf::writeAt ( int fd, uint64_t offset )
+{
+    vector<iovec> pieces;
+    size_t first = 0;       //First piece not completely written
+    ssize_t written;
+
+    for ( size_t i = 0; i < blocks.size(); i++ )
+    {
+        pieces.push_back ( { blocks[i].get(),
+                             i + 1 < blocks.size() ? BLOCK_SIZE : used } );
+    }
+
+    while ( first < pieces.size() )
+    {
+        written = pwritev ( fd, pieces.data() + first,
+                            ( int ) min<size_t> ( pieces.size() - first, IOV_MAX ),
+                            ( off_t ) offset );
+
+        if ( written < 0 && errno == EINTR )
+        {
+            continue;
+        }
+
+        if ( written <= 0 )
+        {
+            return false;
+        }
+
+        offset += ( uint64_t ) written;
+
+        //Skip the pieces that are done, trim a partly written one
+        while ( first < pieces.size() &&
+                ( size_t ) written >= pieces[first].iov_len )
+        {
+            written -= ( ssize_t ) pieces[first].iov_len;
+            first++;
+        }
+
+        if ( first < pieces.size() )
+        {
+            pieces[first].iov_base = ( char * ) pieces[first].iov_base + written;
+            pieces[first].iov_len -= ( size_t ) written;
+        }
+    }
+
+    return true;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function copies written bytes into the blocks, starting a new block
+ * whenever the last one fills.
+ *
+ * @param[in] text - the bytes
+ * @param[in] length - number of bytes
+ *
+ * @returns the number of bytes taken, all of them
+ *
+ ******************************************************************************/
+streamsize SegmentBuf::xsputn ( const char *text, streamsize length )
+{
+    size_t left = ( size_t ) length;
+    size_t room;
+
+    while ( left > 0 )
+    {
+        if ( blocks.empty() || used == BLOCK_SIZE )
+        {
+            blocks.emplace_back ( new char[BLOCK_SIZE] );
+            used = 0;
+        }
+
+        room = min ( left, BLOCK_SIZE - used );
+        memcpy ( blocks.back().get() + used, text, room );
+        used += room;
+        text += room;
+        left -= room;
+    }
+
+    return length;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function takes a single character written to the stream.
+ *
+ * @param[in] c - the character
+ *
+ * @returns the character, or eof when given eof
+ *
+ ******************************************************************************/
+SegmentBuf::int_type SegmentBuf::overflow ( int_type c )
+{
+    char byte;
+
+    if ( traits_type::eq_int_type ( c, traits_type::eof() ) )
+    {
+        return traits_type::not_eof ( c );
+    }
+
+    byte = traits_type::to_char_type ( c );
+    xsputn ( &byte, 1 );
+
+    return c;
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Definition of ReportWriter class
+*
+******************************************************************************/
+
+#include <ostream>
+#include <string_view>
+#include <functional>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+#ifndef __REPORT_H
+#define __REPORT_H
+
+/*!
+ * @brief Layout of the word frequency report
+ */
+enum reportFormat
+{
+    COLUMNS_FORMAT,     /*!< Frequency banners over two columns of words */
+    TSV_FORMAT,         /*!< word<TAB>count lines under a header line */
+    CSV_FORMAT,         /*!< word,count lines under a header line */
+    NDJSON_FORMAT,      /*!< One {"word":...,"count":...} object per line */
+    BINARY_FORMAT       /*!< Packed count, length and word records */
+};
+
+
+
+/*!
+ * @brief writes the word frequency report in one of the report formats,
+ * formatting straight into a buffer that is written out when full
+ */
+class ReportWriter
+{
+    public:
+        ReportWriter ( ostream &out, reportFormat format = COLUMNS_FORMAT,
+                       bool first = true );
+
+        void frequency ( uint64_t count, uint64_t written = 0 );
+        void word ( string_view word );
+        void finish ( bool last = true );
+
+    private:
+        void put ( const char *text, size_t length );
+        void putChar ( char c );
+        void putNumber ( uint64_t number );
+        void putLittle ( uint64_t number, size_t bytes );
+        void putQuoted ( string_view word );
+        void putEscaped ( string_view word );
+        void flushBuffer();
+
+        static const size_t BUFFER_SIZE = 1 << 16; /*!< Size of the buffer */
+
+        ostream &out;           /*!< Where the report is written */
+        reportFormat format;    /*!< Layout of the report */
+        uint64_t count;         /*!< Frequency of the words being written */
+        uint64_t column;        /*!< Words written under the current banner */
+        size_t used;            /*!< Bytes waiting in the buffer */
+        char buffer[BUFFER_SIZE]; /*!< Formatted bytes not yet written */
+};
+
+
+
+/*!
+ * @brief Where one range of a report written in parts starts
+ */
+struct reportPlace
+{
+    size_t group;       /*!< Group the range starts in */
+    uint64_t item;      /*!< Items of that group in the ranges before */
+};
+
+
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+bool parseFormat ( string_view name, reportFormat &format );
+size_t utf8Length ( string_view text, size_t at );
+vector<reportPlace> splitRanges ( const vector<uint64_t> &sizes,
+                                  unsigned parts );
+bool writeSegments ( int fd, unsigned segments,
+                     const function<void ( unsigned, ostream & )> &format );
+
+#endif
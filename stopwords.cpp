@@ -0,0 +1,491 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Implementation of StopWords class
+*
+* @details
+* The built in list is placed in a perfect hash table by the compiler: a seed
+* is searched for at compile time that sends every word to its own slot, so a
+* lookup is one hash, one table read and one compare.
+*
+* Lists loaded from a file get a minimal perfect hash built when they load,
+* using hash and displace. Words are split into buckets of about four; the
+* largest buckets are placed first, each trying displacements until all of
+* its words land in free slots. A lookup hashes the word once, picks the
+* bucket from the scrambled high bits and the slot from the displaced low
+* bits.
+*
+******************************************************************************/
+#include "stopwords.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+#include "tokenizer.h"
+
+
+
+/*!
+ * @brief Common English words left out by --stopwords, already prepared
+ */
+static constexpr const char *BUILT_IN_WORDS[] =
+{
+    "a", "about", "above", "after", "again", "against", "all", "am", "an",
+    "and", "any", "are", "as", "at", "be", "because", "been", "before",
+    "being", "below", "between", "both", "but", "by", "can", "could", "did",
+    "do", "does", "doing", "down", "during", "each", "few", "for", "from",
+    "further", "had", "has", "have", "having", "he", "her", "here", "hers",
+    "herself", "him", "himself", "his", "how", "i", "if", "in", "into", "is",
+    "it", "its", "itself", "just", "me", "more", "most", "my", "myself", "no",
+    "nor", "not", "now", "of", "off", "on", "once", "only", "or", "other",
+    "our", "ours", "ourselves", "out", "over", "own", "same", "she", "should",
+    "so", "some", "such", "than", "that", "the", "their", "theirs", "them",
+    "themselves", "then", "there", "these", "they", "this", "those",
+    "through", "to", "too", "under", "until", "up", "very", "was", "we",
+    "were", "what", "when", "where", "which", "while", "who", "whom", "why",
+    "will", "with", "would", "you", "your", "yours", "yourself", "yourselves"
+};
+
+/*!
+ * @brief Number of built in stop words
+ */
+static constexpr size_t BUILT_IN_COUNT = sizeof ( BUILT_IN_WORDS ) /
+        sizeof ( BUILT_IN_WORDS[0] );
+
+/*!
+ * @brief log2 of the built in table size; sparse enough for a seed to turn up
+ */
+static constexpr int BUILT_IN_BITS = 12;
+
+/*!
+ * @brief Marks a built in table slot with no word
+ */
+static constexpr unsigned char EMPTY_SLOT = 0xff;
+
+static_assert ( BUILT_IN_COUNT < EMPTY_SLOT,
+                "built in stop words must fit in a byte index" );
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function hashes the characters of a word with 64 bit FNV-1a. It is
+ * usable at compile time so the built in table can be laid out by the
+ * compiler.
+ *
+ * @param[in] word - characters of the word
+ * @param[in] length - number of characters
+ *
+ * @returns the hash of the word
+ *
+ *****************************************************************************/
+static constexpr uint64_t stopHash ( const char *word, size_t length )
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for ( size_t i = 0; i < length; i++ )
+    {
+        hash ^= ( unsigned char ) word[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function scrambles a word hash combined with a seed (the splitmix64
+ * finalizer) so that every seed gives an unrelated slot assignment.
+ *
+ * @param[in] x - word hash xor seed
+ *
+ * @returns the scrambled value
+ *
+ *****************************************************************************/
+static constexpr uint64_t stopMix ( uint64_t x )
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+
+    return x;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function counts the characters in a string at compile time.
+ *
+ * @param[in] word - nul terminated string
+ *
+ * @returns the number of characters
+ *
+ *****************************************************************************/
+static constexpr size_t constLength ( const char *word )
+{
+    size_t length = 0;
+
+    while ( word[length] != '\0' )
+    {
+        length++;
+    }
+
+    return length;
+}
+
+
+
+/*!
+ * @brief Perfect hash table for the built in words, laid out at compile time
+ */
+struct builtInTable
+{
+    uint64_t seed;                              /*!< Seed, 0 if none found */
+    unsigned char slot[1 << BUILT_IN_BITS];     /*!< Word index per slot */
+    unsigned char length[BUILT_IN_COUNT];       /*!< Length of each word */
+};
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function searches for a seed that hashes every built in word to its
+ * own slot and fills in the table for it. It runs at compile time.
+ *
+ * @returns the table, with a seed of 0 if no seed worked
+ *
+ *****************************************************************************/
+static constexpr builtInTable buildBuiltIn()
+{
+    builtInTable table {};
+    size_t slot = 0;
+    bool placed = false;
+
+    for ( uint64_t seed = 1; seed < 4096; seed++ )
+    {
+        placed = true;
+
+        for ( size_t i = 0; i < ( 1 << BUILT_IN_BITS ); i++ )
+        {
+            table.slot[i] = EMPTY_SLOT;
+        }
+
+        for ( size_t i = 0; placed && i < BUILT_IN_COUNT; i++ )
+        {
+            table.length[i] = ( unsigned char ) constLength ( BUILT_IN_WORDS[i] );
+            slot = stopMix ( stopHash ( BUILT_IN_WORDS[i], table.length[i] ) ^
+                             seed ) >> ( 64 - BUILT_IN_BITS );
+
+            if ( table.slot[slot] != EMPTY_SLOT )
+            {
+                placed = false;
+            }
+
+            table.slot[slot] = ( unsigned char ) i;
+        }
+
+        if ( placed )
+        {
+            table.seed = seed;
+            return table;
+        }
+    }
+
+    table.seed = 0;
+    return table;
+}
+
+/*!
+ * @brief The built in table, computed by the compiler
+ */
+static constexpr builtInTable BUILT_IN_TABLE = buildBuiltIn();
+
+static_assert ( BUILT_IN_TABLE.seed != 0,
+                "no perfect hash seed found for the built in stop words" );
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates an empty set; nothing is filtered until a list is
+ * chosen.
+ *
+ ******************************************************************************/
+StopWords::StopWords()
+{
+    type = NONE;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function switches the set to the built in list of English words.
+ *
+ ******************************************************************************/
+void StopWords::useBuiltIn()
+{
+    keys.clear();
+    displace.clear();
+    type = BUILT_IN;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads a stop word list from a file, one or more words per
+ * line. Each word is prepared the same way as the words being counted so
+ * that "The," in the list matches "the" in the text. The words are then
+ * placed in a minimal perfect hash table.
+ *
+ * @param[in] name - path of the stop word list
+ *
+ * @returns true - the list was loaded
+ * @returns false - the file did not open or could not be hashed
+ *
+ ******************************************************************************/
+bool StopWords::load ( const char *name )
+{
+    ifstream fin;           //Stop word list
+    string word;            //Word read from the list
+    vector<string> words;   //Prepared words from the list
+
+    fin.open ( name );
+
+    if ( !fin )
+    {
+        return false;
+    }
+
+    while ( fin >> word )
+    {
+        if ( prepareWord ( word ) )
+        {
+            words.push_back ( word );
+        }
+    }
+
+    fin.close();
+
+    //Duplicates would never hash apart
+    sort ( words.begin(), words.end() );
+    words.erase ( unique ( words.begin(), words.end() ), words.end() );
+
+    return build ( words );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function determines if a word is in the set. The word must already be
+ * prepared.
+ *
+ * @param[in] word - the word to look for
+ *
+ * @returns true if the word should be left out
+ * @returns false if the word should be counted
+ *
+ ******************************************************************************/
+bool StopWords::contains ( string_view word )
+{
+    uint64_t hash;
+    uint64_t mixed;
+    size_t slot;
+
+    if ( type == NONE )
+    {
+        return false;
+    }
+
+    hash = stopHash ( word.data(), word.length() );
+
+    if ( type == BUILT_IN )
+    {
+        slot = BUILT_IN_TABLE.slot[stopMix ( hash ^ BUILT_IN_TABLE.seed ) >>
+                             ( 64 - BUILT_IN_BITS )];
+
+        return slot != EMPTY_SLOT &&
+               BUILT_IN_TABLE.length[slot] == word.length() &&
+               memcmp ( BUILT_IN_WORDS[slot], word.data(), word.length() ) == 0;
+    }
+
+    //Bucket from the scrambled high bits, slot from the displaced hash
+    mixed = ( ( stopMix ( hash ) >> 32 ) * displace.size() ) >> 32;
+    mixed = stopMix ( hash ^ displace[mixed] ) & 0xffffffff;
+    slot = ( size_t ) ( ( mixed * keys.size() ) >> 32 );
+
+    return keys[slot] == word;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function determines if the set filters nothing.
+ *
+ * @returns true if no words are filtered.
+ * @returns false if some words are filtered.
+ *
+ ******************************************************************************/
+bool StopWords::isEmpty()
+{
+    return type == NONE;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the number of words in the set.
+ *
+ * @returns the number of stop words
+ *
+ ******************************************************************************/
+int StopWords::size()
+{
+    if ( type == BUILT_IN )
+    {
+        return ( int ) BUILT_IN_COUNT;
+    }
+
+    return ( int ) keys.size();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function builds the minimal perfect hash table for a list of distinct
+ * words. The words are hashed and grouped into buckets. Buckets are placed
+ * largest first; for each one, displacements are tried until every word in
+ * it maps to a different free slot. An empty list filters nothing.
+ *
+ * @param[in,out] words - distinct prepared words, emptied by the call
+ *
+ * @returns true - the table was built
+ * @returns false - two words could not be separated
+ *
+ ******************************************************************************/
+bool StopWords::build ( vector<string> &words )
+{
+    size_t count = words.size();
+    size_t bucketCount = ( count + 3 ) / 4;
+    vector<uint64_t> hashes ( count );
+    vector<vector<uint32_t>> buckets ( bucketCount );
+    vector<uint32_t> order ( bucketCount );
+    vector<bool> taken ( count, false );
+    vector<size_t> slots;
+    size_t slot;
+    bool placed;
+
+    keys.clear();
+    displace.clear();
+    type = NONE;
+
+    if ( count == 0 )
+    {
+        return true;
+    }
+
+    //Group the words into buckets by the high bits of their hash; FNV-1a
+    //alone leaves the high bits of short, similar words clumped
+    for ( size_t i = 0; i < count; i++ )
+    {
+        hashes[i] = stopHash ( words[i].data(), words[i].length() );
+        buckets[ ( ( stopMix ( hashes[i] ) >> 32 ) * bucketCount ) >> 32]
+        .push_back ( ( uint32_t ) i );
+    }
+
+    //Place the largest buckets while the table is still empty
+    for ( size_t i = 0; i < bucketCount; i++ )
+    {
+        order[i] = ( uint32_t ) i;
+    }
+
+    stable_sort ( order.begin(), order.end(), [&] ( uint32_t l, uint32_t r )
+    {
+        return buckets[l].size() > buckets[r].size();
+    } );
+
+    displace.assign ( bucketCount, 0 );
+    keys.resize ( count );
+
+    for ( uint32_t b : order )
+    {
+        placed = buckets[b].empty();
+
+        for ( uint32_t d = 1; !placed && d < ( 1u << 24 ); d++ )
+        {
+            placed = true;
+            slots.clear();
+
+            for ( uint32_t w : buckets[b] )
+            {
+                slot = ( size_t ) ( ( ( stopMix ( hashes[w] ^ d ) & 0xffffffff ) *
+                                      count ) >> 32 );
+
+                if ( taken[slot] ||
+                        find ( slots.begin(), slots.end(), slot ) != slots.end() )
+                {
+                    placed = false;
+                    break;
+                }
+
+                slots.push_back ( slot );
+            }
+
+            if ( placed )
+            {
+                displace[b] = d;
+            }
+        }
+
+        if ( !placed )
+        {
+            keys.clear();
+            displace.clear();
+            return false;
+        }
+
+        for ( size_t i = 0; i < buckets[b].size(); i++ )
+        {
+            taken[slots[i]] = true;
+            keys[slots[i]] = move ( words[buckets[b][i]] );
+        }
+    }
+
+    words.clear();
+    type = CUSTOM;
+
+    return true;
+}
@@ -0,0 +1,51 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Definition of StopWords class
+*
+******************************************************************************/
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+#ifndef __STOPWORDS_H
+#define __STOPWORDS_H
+
+/*!
+ * @brief set of words to leave out of the results, looked up with a perfect
+ * hash so checking a word costs one hash and one compare
+ */
+class StopWords
+{
+    public:
+        StopWords();
+
+        void useBuiltIn();
+        bool load ( const char *name );
+        bool contains ( string_view word );
+        bool isEmpty();
+        int size();
+
+    private:
+        bool build ( vector<string> &words );
+
+        /*!
+        * @brief Which list the set is currently using
+        */
+        enum listType
+        {
+            NONE,               /*!< No words are filtered */
+            BUILT_IN,           /*!< The compile time list of English words */
+            CUSTOM              /*!< A list loaded from a file */
+        };
+
+        listType type;              /*!< List in use */
+        vector<string> keys;        /*!< Loaded words, each at its hash slot */
+        vector<uint32_t> displace;  /*!< Hash displacement for each bucket */
+};
+
+#endif
@@ -0,0 +1,196 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Implementation of the functions that split text into prepared words
+*
+* @details
+* Words are split exactly the way reading a string with >> splits them in the
+* "C" locale, so counting from a buffer gives the same words as counting from
+* a stream.
+*
+******************************************************************************/
+#include "tokenizer.h"
+
+#include <cctype>
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function determines if a character separates words; the same
+ * characters isspace accepts in the "C" locale.
+ *
+ * @param[in] c - character to check
+ *
+ * @returns true - the character is white space
+ * @returns false - the character is part of a word
+ *
+ *****************************************************************************/
+bool isSeparator ( char c )
+{
+    return c == ' ' || ( c >= '\t' && c <= '\r' );
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function finds the next word in a buffer. White space is skipped, then
+ * the word runs until the next white space or the end of the buffer. The
+ * position is moved past the word so the next call finds the one after it.
+ *
+ * @param[in,out] pos - where to start looking, moved past the word found
+ * @param[in]     end - one past the last character of the buffer
+ * @param[out]    word - first character of the word
+ * @param[out]    length - number of characters in the word
+ *
+ * @returns true - a word was found
+ * @returns false - only white space was left
+ *
+ *****************************************************************************/
+bool nextToken ( const char *&pos, const char *end, const char *&word,
+                 size_t &length )
+{
+    //Skip leading white space
+    while ( pos < end && isSeparator ( *pos ) )
+    {
+        pos++;
+    }
+
+    if ( pos == end )
+    {
+        return false;
+    }
+
+    //Run to the end of the word
+    word = pos;
+
+    while ( pos < end && !isSeparator ( *pos ) )
+    {
+        pos++;
+    }
+
+    length = pos - word;
+
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Nicholas Wendt
+ *
+ * @par Description:
+ * This function finds the part of a word left once punctuation is removed
+ * from the front and end. First, the function traverses the word until the
+ * first and last non punctuation characters are found. If the entire word is
+ * punctuation, false is returned.
+ *
+ * @param[in]  word - characters of the word
+ * @param[in]  length - number of characters in the word
+ * @param[out] first - index of the first character to keep
+ * @param[out] count - number of characters to keep
+ *
+ * @returns true - the word is valid (should be added to the list)
+ * @returns false - the word is all punctuation
+ *
+ *****************************************************************************/
+bool trimWord ( const char *word, size_t length, size_t &first,
+                size_t &count )
+{
+    long long i = 0;                        //Start on first character
+    long long end = ( long long ) length - 1; //End on last character
+
+
+
+    //Find first non punct character
+    while ( i < end && ispunct ( ( unsigned char ) word[i] ) )
+    {
+        i++;
+    }
+
+    //Find last non punct character
+    while ( end > -1 && ispunct ( ( unsigned char ) word[end] ) )
+    {
+        end--;
+    }
+
+    //If whole word was punct
+    if ( i > end )
+    {
+        //Whole word was punct
+        return false;
+    }
+
+    first = ( size_t ) i;
+    count = ( size_t ) ( end + 1 - i );
+
+    //Word is good
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function copies a word converting it to lower case. Only A through Z
+ * change, the same as tolower in the "C" locale.
+ *
+ * @param[in]  word - characters of the word
+ * @param[in]  length - number of characters in the word
+ * @param[out] dest - where the lower case word is written, may be word
+ *
+ *****************************************************************************/
+void lowerWord ( const char *word, size_t length, char *dest )
+{
+    for ( size_t i = 0; i < length; i++ )
+    {
+        dest[i] = ( word[i] >= 'A' && word[i] <= 'Z' ) ? word[i] + 32 : word[i];
+    }
+}
+
+
+
+/**************************************************************************//**
+ * @author Nicholas Wendt
+ *
+ * @par Description:
+ * This function removes the punctuation from the front and end of the given
+ * word. The word is also converted to lower case. If the entire word is
+ * punctuation, false is returned. The word's punctuation is removed and the
+ * word is converted to lower case.
+ *
+ * @param[in,out] word - word to be processed
+ *
+ * @returns true - the word is valid (should be added to the list)
+ * @returns false - the word is all punctuation
+ *
+ *****************************************************************************/
+bool prepareWord ( string &word )
+{
+    size_t first = 0;   //First character kept
+    size_t count = 0;   //Number of characters kept
+
+
+
+    //If whole word was punct
+    if ( !trimWord ( word.data(), word.length(), first, count ) )
+    {
+        return false;
+    }
+
+    //Get substring without punct
+    word = word.substr ( first, count );
+
+    //Convert to lower case
+    lowerWord ( word.data(), word.length(), &word[0] );
+
+    //Word is good
+    return true;
+}
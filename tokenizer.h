@@ -0,0 +1,27 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Definition of the functions that split text into prepared words
+*
+******************************************************************************/
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+#ifndef __TOKENIZER_H
+#define __TOKENIZER_H
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+bool isSeparator ( char c );
+bool nextToken ( const char *&pos, const char *end, const char *&word,
+                 size_t &length );
+bool trimWord ( const char *word, size_t length, size_t &first,
+                size_t &count );
+void lowerWord ( const char *word, size_t length, char *dest );
+bool prepareWord ( string &word );
+
+#endif
@@ -0,0 +1,1273 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Implementation of WordCounter class
+*
+* @details
+* Text is split and prepared exactly as the programs do it, so counts match
+* the reports they write. Words are prepared in a scratch buffer that only
+* grows. The queries walk the table's frequency buckets from the highest
+* count down, sorting only the buckets they visit into a scratch list that
+* also only grows, so after warming up none of the calls allocate.
+*
+* Under a memory limit the counter turns to lossy counting once the table
+* would grow past it, pruning the rarest words and keeping an error bound
+* on what the counts kept may have lost.
+*
+* The variants of a word, the ways it was capitalized, can be counted too.
+* The table stays keyed by the lower case word; next to each entry is the
+* case of the first variant seen, as a bit for each upper case letter, and
+* its count is whatever the other variants leave of the word's count. Only
+* a word seen a second way gets a chain of the other variants, so counting
+* a word the usual way costs one compare.
+*
+******************************************************************************/
+#include "wordcounter.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+
+
+/*!
+ * @brief Number of bytes read from a stream at a time
+ */
+static const size_t CHUNK_SIZE = 1 << 16;
+
+/*!
+ * @brief Bytes in front of the table in an image: the number of words
+ * counted, padded to a cache line
+ */
+static const size_t IMAGE_HEADER = 64;
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates a counter with no words and no stop words.
+ *
+ ******************************************************************************/
+WordCounter::WordCounter()
+{
+    stop = nullptr;
+    total = 0;
+    window = 0;
+    epoch = 0;
+    memoryLimit = 0;
+    bound = 0;
+    carried = 0;
+    pruned = 0;
+    variants = false;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function sets the words to leave out of the counts. The set is not
+ * copied and must outlive the counter.
+ *
+ * @param[in] stop - the stop words, nullptr to count everything
+ *
+ ******************************************************************************/
+void WordCounter::setStopWords ( StopWords *stop )
+{
+    this->stop = stop;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function counts every word in a block of text. The end of the block
+ * ends the last word.
+ *
+ * @param[in] text - the text to count
+ *
+ ******************************************************************************/
+void WordCounter::ingest ( span<const char> text )
+{
+    const char *pos = text.data();
+    const char *end = text.data() + text.size();
+    const char *word = nullptr;
+    size_t length = 0;
+
+    while ( nextToken ( pos, end, word, length ) )
+    {
+        addToken ( word, length );
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function counts every word in several blocks of text, each counted as
+ * if passed to ingest on its own.
+ *
+ * @param[in] texts - the blocks of text to count
+ *
+ ******************************************************************************/
+void WordCounter::ingestBatch ( span<const span<const char>> texts )
+{
+    for ( span<const char> text : texts )
+    {
+        ingest ( text );
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function counts every word read from a stream. The stream is read a
+ * block at a time; a word cut off at the end of a block is carried over to
+ * the front of the next one.
+ *
+ * @param[in,out] in - the stream to read
+ *
+ * @returns true - the stream was read to the end
+ * @returns false - the stream went bad while reading
+ *
+ ******************************************************************************/
+bool WordCounter::ingest ( istream &in )
+{
+    size_t carry = 0;   //Characters of an unfinished word at the front
+    size_t filled = 0;  //Characters in the block
+    size_t cut = 0;     //End of the last whole word in the block
+
+    if ( chunk.size() < CHUNK_SIZE )
+    {
+        chunk.resize ( CHUNK_SIZE );
+    }
+
+    while ( true )
+    {
+        //One word filled the whole block, make room
+        if ( carry == chunk.size() )
+        {
+            chunk.resize ( chunk.size() * 2 );
+        }
+
+        in.read ( chunk.data() + carry, chunk.size() - carry );
+        filled = carry + ( size_t ) in.gcount();
+
+        if ( !in )
+        {
+            ingest ( span<const char> ( chunk.data(), filled ) );
+            break;
+        }
+
+        //Back up to the white space before the last word
+        cut = filled;
+
+        while ( cut > 0 && !isSeparator ( chunk[cut - 1] ) )
+        {
+            cut--;
+        }
+
+        ingest ( span<const char> ( chunk.data(), cut ) );
+
+        carry = filled - cut;
+        memmove ( chunk.data(), chunk.data() + cut, carry );
+    }
+
+    return !in.bad();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function adds another counter's counts to this one, as if its text
+ * had been counted here too, times times over. The words are already
+ * prepared and filtered, so they are added as they are, bucket by bucket.
+ * With a window they count toward the current epoch. If the other counter
+ * pruned words, its error bound carries over, and if both count variants,
+ * the other's variants are added too.
+ *
+ * @param[in] other - the counter to add
+ * @param[in] times - how many times to add it
+ *
+ ******************************************************************************/
+void WordCounter::merge ( WordCounter &other, uint64_t times )
+{
+    WordTable &from = other.table;
+    uint32_t index;
+    uint64_t amount;
+
+    for ( uint32_t group = from.highestBucket(); group != WordTable::NONE;
+            group = from.lowerBucket ( group ) )
+    {
+        amount = from.bucketCount ( group ) * times;
+
+        for ( uint32_t i = from.firstInBucket ( group ); i != WordTable::NONE;
+                i = from.nextInBucket ( i ) )
+        {
+            string_view word = from.word ( i );
+
+            index = addWord ( word.data(), word.length(), amount );
+
+            if ( variants && other.variants )
+            {
+                mergeVariants ( index, table.count ( index ) == amount, other,
+                                i, times );
+            }
+        }
+    }
+
+    total += other.total * times;
+    carried += other.errorBound() * times;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function makes the counter keep only the counts of the last few
+ * epochs instead of everything since it started. What an epoch is, a few
+ * seconds or a number of log lines, is up to the caller, who ends each one
+ * with advanceEpoch. Any counts already made are dropped.
+ *
+ * @param[in] epochs - epochs in the window, the current one included; 0
+ * keeps every count
+ *
+ ******************************************************************************/
+void WordCounter::setWindow ( size_t epochs )
+{
+    clear();
+    window = epochs;
+    this->epochs.assign ( epochs, {} );
+    epochWords.assign ( epochs, 0 );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function ends the current epoch. Once the window is full the oldest
+ * epoch falls out of it: what was counted in it is taken back out of the
+ * table, one subtraction per word it held, and words left with nothing are
+ * removed. The buckets follow along, so the top words and the words with a
+ * given count are right at once. Every token is added once and taken back
+ * once, so the cost per token stays constant.
+ *
+ ******************************************************************************/
+void WordCounter::advanceEpoch()
+{
+    size_t slot;
+
+    if ( window == 0 )
+    {
+        return;
+    }
+
+    epoch++;
+    slot = epoch % window;
+
+    for ( const epochCount &expired : epochs[slot] )
+    {
+        table.subtract ( expired.index, expired.count );
+    }
+
+    total -= epochWords[slot];
+    epochWords[slot] = 0;
+    epochs[slot].clear();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function caps the memory the counts may take. Until the cap is
+ * reached every count is exact. After that the counter counts lossily, as
+ * in Manku and Motwani's lossy counting: whenever a new word would take the
+ * table over the cap, the rarest words are pruned until a quarter of the
+ * table is free again. Each pruning raises an error bound to the largest
+ * count (plus the count the word may have lost earlier) pruned so far, and
+ * a word counted after a pruning is noted as possibly already having lost
+ * that much. Every count kept is then low by at most the bound, and every
+ * word that occurred more often than the bound is still counted. The cap
+ * is not used with a window.
+ *
+ * @param[in] bytes - memory the table may take, 0 for no cap
+ *
+ ******************************************************************************/
+void WordCounter::setMemoryLimit ( size_t bytes )
+{
+    memoryLimit = bytes;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function makes the counter count each variant of a word, every way
+ * it was capitalized, as well as the word itself. The word counts and the
+ * reports on them do not change; reportVariants writes the variants. Case
+ * is kept for the first 64 characters of a word. It is set before anything
+ * is counted, and is not used with a window or a memory limit.
+ *
+ * @param[in] track - true to count the variants
+ *
+ ******************************************************************************/
+void WordCounter::setVariants ( bool track )
+{
+    variants = track;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns how far the counts may be low because words were
+ * pruned to stay under the memory limit.
+ *
+ * @returns the most any count may be low by, 0 if the counts are exact
+ *
+ ******************************************************************************/
+uint64_t WordCounter::errorBound()
+{
+    return bound + carried;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns how many times a word was pruned to stay under the
+ * memory limit. A word pruned and counted again is counted each time.
+ *
+ * @returns the number of words pruned
+ *
+ ******************************************************************************/
+uint64_t WordCounter::prunedWords()
+{
+    return pruned;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the memory the counts take: the table and the
+ * count each word may have lost to pruning.
+ *
+ * @returns the number of bytes reserved
+ *
+ ******************************************************************************/
+size_t WordCounter::memoryUsed()
+{
+    return table.memoryUsed() + undercount.capacity() * sizeof ( uint64_t );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the number of times a word was counted. The word is
+ * prepared first, so "The," finds "the".
+ *
+ * @param[in] word - the word to look up
+ *
+ * @returns the word's count, 0 if it was never counted
+ *
+ ******************************************************************************/
+uint64_t WordCounter::count ( string_view word )
+{
+    string_view prepared;
+    uint32_t index;
+
+    if ( !prepare ( word.data(), word.length(), prepared ) )
+    {
+        return 0;
+    }
+
+    index = table.find ( prepared.data(), prepared.length() );
+
+    if ( index == WordTable::NONE )
+    {
+        return 0;
+    }
+
+    return table.count ( index );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function fills in the most frequent words, in report order. The words
+ * are views into the counter and stay valid until more text is counted.
+ *
+ * @param[in]  k - largest number of words wanted
+ * @param[out] out - where the words are written
+ *
+ * @returns the number of words written; less than k if out is smaller or
+ * fewer words were counted
+ *
+ ******************************************************************************/
+size_t WordCounter::topK ( size_t k, span<wordCount> out )
+{
+    uint32_t group = table.highestBucket();
+    size_t wanted = min ( k, out.size() );
+    size_t n = 0;
+
+    while ( group != WordTable::NONE && n < wanted )
+    {
+        //Only the first words of the last bucket needed are sorted
+        gatherBucket ( group, 0, wanted - n, keys, members );
+
+        for ( uint32_t index : members )
+        {
+            out[n].word = table.word ( index );
+            out[n].count = table.bucketCount ( group );
+            n++;
+        }
+
+        group = table.lowerBucket ( group );
+    }
+
+    return n;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes the word frequency report, the same one the program
+ * writes to its output file. The words go from the bucket walk straight to
+ * the writer's buffer.
+ *
+ * @param[out] out - where the report is written
+ * @param[in]  format - layout of the report
+ *
+ ******************************************************************************/
+void WordCounter::report ( ostream &out, reportFormat format )
+{
+    ReportWriter writer ( out, format );
+    uint32_t group = table.highestBucket();
+
+    while ( group != WordTable::NONE )
+    {
+        writeBucket ( group, 0, table.bucketSize ( group ), keys, members,
+                      writer );
+        group = table.lowerBucket ( group );
+    }
+
+    writer.finish();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes the same report using several threads. The words
+ * are split into ranges holding about the same number of words, cutting a
+ * bucket too large for one range; each thread sorts and formats one range
+ * with its own scratch space, and the ranges are written to the file in
+ * order.
+ *
+ * @param[in] fd - file to write, from its start
+ * @param[in] format - layout of the report
+ * @param[in] threads - number of threads to use
+ *
+ * @returns true - the report was written
+ * @returns false - memory ran out or a write failed
+ *
+ ******************************************************************************/
+bool WordCounter::report ( int fd, reportFormat format, unsigned threads )
+{
+    vector<uint32_t> groups;    //Buckets from the highest count down
+    vector<uint64_t> sizes;     //Words in each bucket
+    vector<reportPlace> bounds; //Where each range starts
+
+    for ( uint32_t group = table.highestBucket(); group != WordTable::NONE;
+            group = table.lowerBucket ( group ) )
+    {
+        groups.push_back ( group );
+        sizes.push_back ( table.bucketSize ( group ) );
+    }
+
+    bounds = splitRanges ( sizes, threads );
+
+    return writeSegments ( fd, ( unsigned ) bounds.size() - 1,
+                           [&] ( unsigned segment, ostream &out )
+    {
+        ReportWriter writer ( out, format, segment == 0 );
+        reportPlace from = bounds[segment];
+        reportPlace to = bounds[segment + 1];
+        vector<sortKey> sorting;
+        vector<uint32_t> sorted;
+        uint64_t first;
+        uint64_t last;
+
+        for ( size_t i = from.group; i < groups.size() && i <= to.group; i++ )
+        {
+            first = i == from.group ? from.item : 0;
+            last = i == to.group ? to.item : sizes[i];
+
+            if ( first < last )
+            {
+                writeBucket ( groups[i], ( size_t ) first,
+                              ( size_t ) ( last - first ), sorting, sorted,
+                              writer );
+            }
+        }
+
+        writer.finish ( segment + 2 == bounds.size() );
+    } );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes every variant of every word as word<TAB>variant<TAB>
+ * count lines under a header line. The words come in the order of the
+ * report, and each word's variants from the most frequent down, upper case
+ * before lower case when they tie, so a word's variant counts add up to its
+ * count.
+ *
+ * @param[out] out - the stream to write to
+ *
+ ******************************************************************************/
+void WordCounter::reportVariants ( ostream &out )
+{
+    string text = "word\tvariant\tcount\n"; //Lines not yet written
+    char number[24];
+    string_view word;
+    to_chars_result written;
+
+    for ( uint32_t group = table.highestBucket(); group != WordTable::NONE;
+            group = table.lowerBucket ( group ) )
+    {
+        gatherBucket ( group, 0, table.bucketSize ( group ), keys, members );
+
+        for ( uint32_t index : members )
+        {
+            word = table.word ( index );
+            gatherVariants ( index, found );
+
+            for ( const variantCount &v : found )
+            {
+                text.append ( word );
+                text += '\t';
+
+                for ( size_t i = 0; i < word.length(); i++ )
+                {
+                    text += ( i < 64 && ( v.upper >> i & 1 ) ) ?
+                            char ( word[i] - 32 ) : word[i];
+                }
+
+                text += '\t';
+                written = to_chars ( number, number + sizeof ( number ),
+                                     v.count );
+                text.append ( number, written.ptr );
+                text += '\n';
+            }
+
+            if ( text.size() >= CHUNK_SIZE )
+            {
+                out.write ( text.data(), text.size() );
+                text.clear();
+            }
+        }
+    }
+
+    out.write ( text.data(), text.size() );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the number of different words counted.
+ *
+ * @returns the number of distinct words
+ *
+ ******************************************************************************/
+size_t WordCounter::distinctWords()
+{
+    return table.size();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the number of words counted, repeats included.
+ *
+ * @returns the number of words
+ *
+ ******************************************************************************/
+uint64_t WordCounter::totalWords()
+{
+    return total;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function forgets every word counted so far. A window, memory limit
+ * or the counting of variants stays set, and starts again empty.
+ *
+ ******************************************************************************/
+void WordCounter::clear()
+{
+    table.clear();
+    total = 0;
+    epoch = 0;
+    recent.clear();
+    bound = 0;
+    carried = 0;
+    pruned = 0;
+    undercount.clear();
+    heads.clear();
+    cases.clear();
+
+    for ( size_t i = 0; i < epochs.size(); i++ )
+    {
+        epochs[i].clear();
+        epochWords[i] = 0;
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the number of bytes an image of the counts takes.
+ *
+ * @returns the size of the image
+ *
+ ******************************************************************************/
+size_t WordCounter::imageSize()
+{
+    return IMAGE_HEADER + table.imageSize();
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function saves the counts as an image, the number of words counted
+ * followed by the table's image (see WordTable::saveImage). A window, memory
+ * limit or variants are not part of the image.
+ *
+ * @param[out] image - where the image goes, imageSize bytes
+ *
+ ******************************************************************************/
+void WordCounter::saveImage ( char *image )
+{
+    memset ( image, 0, IMAGE_HEADER );
+    memcpy ( image, &total, sizeof ( total ) );
+    table.saveImage ( image + IMAGE_HEADER );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function replaces the counts with ones saved by saveImage.
+ *
+ * @param[in] image - the image
+ * @param[in] size - number of bytes in the image
+ *
+ * @returns true - the counts were loaded
+ * @returns false - the image is not one this build can load; the counts
+ * are unchanged
+ *
+ ******************************************************************************/
+bool WordCounter::loadImage ( const char *image, size_t size )
+{
+    if ( size < IMAGE_HEADER ||
+            !table.loadImage ( image + IMAGE_HEADER, size - IMAGE_HEADER ) )
+    {
+        return false;
+    }
+
+    memcpy ( &total, image, sizeof ( total ) );
+    return true;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function prepares a word and counts it unless it is a stop word,
+ * along with the way it was capitalized when variants are counted.
+ *
+ * @param[in] word - characters of the word as found in the text
+ * @param[in] length - number of characters
+ *
+ ******************************************************************************/
+void WordCounter::addToken ( const char *word, size_t length )
+{
+    string_view prepared;
+    uint64_t upper = 0;
+    uint32_t index;
+
+    if ( !prepare ( word, length, prepared, variants ? &upper : nullptr ) )
+    {
+        return;
+    }
+
+    if ( stop != nullptr && stop->contains ( prepared ) )
+    {
+        return;
+    }
+
+    index = addWord ( prepared.data(), prepared.length(), 1 );
+    total++;
+
+    if ( variants )
+    {
+        addVariant ( index, upper, 1, table.count ( index ) == 1 );
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function adds to a prepared word's count. Under a memory limit, the
+ * rarest words are pruned first if the word is new and the table would
+ * otherwise grow over the limit; a new word is noted as possibly having
+ * lost as much as the error bound. With a window the count is recorded
+ * against the current epoch.
+ *
+ * @param[in] word - characters of the prepared word
+ * @param[in] length - number of characters
+ * @param[in] amount - how much to add to the count
+ *
+ * @returns the index of the word's entry
+ *
+ ******************************************************************************/
+uint32_t WordCounter::addWord ( const char *word, size_t length,
+                                uint64_t amount )
+{
+    uint32_t index;
+    size_t growth = 0;
+
+    if ( memoryLimit != 0 && window == 0 )
+    {
+        //The losses grow with the entries, when none is free for reuse
+        if ( table.size() >= undercount.size() &&
+                undercount.size() == undercount.capacity() )
+        {
+            growth = max<size_t> ( undercount.capacity(), 1 ) *
+                     sizeof ( uint64_t );
+        }
+
+        growth += table.memoryToAdd ( length );
+
+        //Only a word that would make the table grow can take it over
+        if ( growth != 0 && memoryUsed() + growth > memoryLimit &&
+                table.find ( word, length ) == WordTable::NONE )
+        {
+            prune();
+        }
+    }
+
+    index = table.add ( word, length, amount );
+
+    if ( window != 0 )
+    {
+        record ( index, amount );
+    }
+    else if ( memoryLimit != 0 )
+    {
+        if ( index >= undercount.size() )
+        {
+            undercount.resize ( index + 1, 0 );
+        }
+
+        //New, so it may have been counted and pruned before
+        if ( table.count ( index ) == amount )
+        {
+            undercount[index] = bound;
+        }
+    }
+
+    return index;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function prunes the rarest words until a quarter of the table is
+ * free. Every word's count plus what it may have lost is above the error
+ * bound, so the bound is raised to the least of them and the words at the
+ * bound are removed, over again until enough are gone.
+ *
+ ******************************************************************************/
+void WordCounter::prune()
+{
+    size_t target = table.size() - table.size() / 4;
+    uint64_t least = pruneTo ( bound );
+
+    while ( table.size() > target && least != UINT64_MAX )
+    {
+        bound = least;
+        least = pruneTo ( bound );
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function removes every word whose count plus what it may have lost
+ * is at most limit. The buckets are walked up from the lowest count, only
+ * as far as a bucket could still hold a word to remove or a word with less
+ * left than the ones seen.
+ *
+ * @param[in] limit - the highest count plus loss to remove
+ *
+ * @returns the least count plus loss among the words kept, UINT64_MAX if
+ * none are left
+ *
+ ******************************************************************************/
+uint64_t WordCounter::pruneTo ( uint64_t limit )
+{
+    uint64_t least = UINT64_MAX;
+    uint64_t count;
+    uint64_t weight;
+    uint32_t group = table.lowestBucket();
+    uint32_t higher;
+    uint32_t next;
+
+    while ( group != WordTable::NONE )
+    {
+        count = table.bucketCount ( group );
+
+        if ( count > limit && count >= least )
+        {
+            break;
+        }
+
+        //Removing the last entry frees the bucket
+        higher = table.higherBucket ( group );
+
+        for ( uint32_t i = table.firstInBucket ( group ); i != WordTable::NONE;
+                i = next )
+        {
+            next = table.nextInBucket ( i );
+            weight = count + ( i < undercount.size() ? undercount[i] : 0 );
+
+            if ( weight <= limit )
+            {
+                table.subtract ( i, count );
+                pruned++;
+            }
+            else
+            {
+                least = min ( least, weight );
+            }
+        }
+
+        group = higher;
+    }
+
+    return least;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function notes that a word was counted in the current epoch, so it
+ * can be taken back when the epoch leaves the window. A word counted again
+ * in the same epoch adds to the note it already has there.
+ *
+ * @param[in] index - the word's entry
+ * @param[in] amount - how much was added to its count
+ *
+ ******************************************************************************/
+void WordCounter::record ( uint32_t index, uint64_t amount )
+{
+    vector<epochCount> &now = epochs[epoch % window];
+
+    if ( index >= recent.size() )
+    {
+        recent.resize ( max<size_t> ( index + 1, recent.size() * 2 ),
+                        { UINT64_MAX, 0 } );
+    }
+
+    recentCount &last = recent[index];
+
+    if ( last.epoch == epoch )
+    {
+        now[last.pair].count += amount;
+    }
+    else
+    {
+        last = { epoch, ( uint32_t ) now.size() };
+        now.push_back ( { index, amount } );
+    }
+
+    epochWords[epoch % window] += amount;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function counts a variant of a word. A new word starts out with the
+ * variant as its first; a variant the word was seen with before adds to its
+ * count, and a different one is chained to the word's other variants.
+ *
+ * @param[in] index - the word's entry
+ * @param[in] upper - the variant's upper case letters
+ * @param[in] amount - how much was added to the word's count
+ * @param[in] fresh - true if the word was just added to the table
+ *
+ ******************************************************************************/
+void WordCounter::addVariant ( uint32_t index, uint64_t upper, uint64_t amount,
+                               bool fresh )
+{
+    uint32_t v;
+
+    if ( index >= heads.size() )
+    {
+        heads.resize ( index + 1 );
+    }
+
+    variantHead &head = heads[index];
+
+    //The first variant's count is what the others leave of the word's
+    if ( fresh )
+    {
+        head = { upper, WordTable::NONE };
+        return;
+    }
+
+    if ( head.upper == upper )
+    {
+        return;
+    }
+
+    for ( v = head.more; v != WordTable::NONE; v = cases[v].next )
+    {
+        if ( cases[v].upper == upper )
+        {
+            cases[v].count += amount;
+            return;
+        }
+    }
+
+    cases.push_back ( { upper, amount, head.more } );
+    head.more = ( uint32_t ) ( cases.size() - 1 );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function adds the variants of one of another counter's words to the
+ * same word here, times times over.
+ *
+ * @param[in] index - the word's entry here
+ * @param[in] fresh - true if the word was just added here
+ * @param[in] other - the counter the word came from
+ * @param[in] from - the word's entry in other
+ * @param[in] times - how many times to add the variants
+ *
+ ******************************************************************************/
+void WordCounter::mergeVariants ( uint32_t index, bool fresh,
+                                  WordCounter &other, uint32_t from,
+                                  uint64_t times )
+{
+    other.gatherVariants ( from, other.found );
+
+    //The most frequent becomes the first variant if the word is new
+    for ( const variantCount &v : other.found )
+    {
+        addVariant ( index, v.upper, v.count * times, fresh );
+        fresh = false;
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function lists a word's variants with their counts, the most frequent
+ * first and upper case first when counts tie.
+ *
+ * @param[in]  index - the word's entry
+ * @param[out] list - the variants
+ *
+ ******************************************************************************/
+void WordCounter::gatherVariants ( uint32_t index, vector<variantCount> &list )
+{
+    uint64_t rest = table.count ( index );
+    variantHead head = index < heads.size() ? heads[index] :
+                       variantHead { 0, WordTable::NONE };
+
+    list.clear();
+
+    for ( uint32_t v = head.more; v != WordTable::NONE; v = cases[v].next )
+    {
+        list.push_back ( cases[v] );
+        rest -= cases[v].count;
+    }
+
+    list.push_back ( { head.upper, rest, WordTable::NONE } );
+
+    //The lowest differing letter decides, and upper case sorts first
+    sort ( list.begin(), list.end(), [] ( const variantCount &l,
+                                          const variantCount &r )
+    {
+        uint64_t differ = l.upper ^ r.upper;
+
+        if ( l.count != r.count )
+        {
+            return l.count > r.count;
+        }
+
+        return ( l.upper & differ & -differ ) != 0;
+    } );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function removes the punctuation from the front and end of a word and
+ * converts it to lower case in the scratch buffer. If asked, the letters that
+ * were upper case are noted too, one bit for each of the first 64
+ * characters.
+ *
+ * @param[in]  word - characters of the word
+ * @param[in]  length - number of characters
+ * @param[out] prepared - the prepared word, valid until the next call
+ * @param[out] upper - the upper case letters, if not nullptr
+ *
+ * @returns true - the word is valid (should be counted)
+ * @returns false - the word is all punctuation
+ *
+ ******************************************************************************/
+bool WordCounter::prepare ( const char *word, size_t length,
+                            string_view &prepared, uint64_t *upper )
+{
+    size_t first = 0;
+    size_t count = 0;
+
+    if ( !trimWord ( word, length, first, count ) )
+    {
+        return false;
+    }
+
+    if ( scratch.size() < count )
+    {
+        scratch.resize ( count );
+    }
+
+    lowerWord ( word + first, count, &scratch[0] );
+    prepared = string_view ( scratch.data(), count );
+
+    if ( upper != nullptr )
+    {
+        *upper = 0;
+
+        for ( size_t i = 0; i < count && i < 64; i++ )
+        {
+            if ( word[first + i] >= 'A' && word[first + i] <= 'Z' )
+            {
+                *upper |= 1ull << i;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function fills a list with the entries of a bucket in alphabetical
+ * order. When fewer than all of them are wanted only that many are sorted,
+ * and when the first ones are not wanted they are only separated from the
+ * rest, not sorted. Each entry is sorted along with the first 8
+ * characters of its word packed into a number, so most comparisons never
+ * leave the key array; only words sharing those characters are compared in
+ * full.
+ *
+ * @param[in]  group - the bucket
+ * @param[in]  first - entries skipped at the start of the order
+ * @param[in]  limit - largest number of entries wanted after them
+ * @param[out] sorting - scratch space for the keys
+ * @param[out] sorted - the entries, in alphabetical order
+ *
+ ******************************************************************************/
+void WordCounter::gatherBucket ( uint32_t group, size_t first, size_t limit,
+                                 vector<sortKey> &sorting,
+                                 vector<uint32_t> &sorted )
+{
+    uint32_t index = table.firstInBucket ( group );
+    string_view word;
+    uint64_t prefix;
+    auto byWord = [this] ( const sortKey &l, const sortKey &r )
+    {
+        if ( l.prefix != r.prefix )
+        {
+            return l.prefix < r.prefix;
+        }
+
+        return table.word ( l.index ) < table.word ( r.index );
+    };
+
+    sorting.clear();
+
+    while ( index != WordTable::NONE )
+    {
+        //Big endian so the numbers order like the characters
+        word = table.word ( index );
+        prefix = 0;
+
+        for ( size_t i = 0; i < 8; i++ )
+        {
+            prefix = prefix << 8 | ( i < word.length() ?
+                                     ( unsigned char ) word[i] : 0 );
+        }
+
+        sorting.push_back ( { prefix, index } );
+        index = table.nextInBucket ( index );
+    }
+
+    //Leave out the entries an earlier part of the report writes
+    if ( first >= sorting.size() )
+    {
+        sorting.clear();
+    }
+    else if ( first > 0 )
+    {
+        nth_element ( sorting.begin(), sorting.begin() + first, sorting.end(),
+                      byWord );
+        sorting.erase ( sorting.begin(), sorting.begin() + first );
+    }
+
+    if ( limit < sorting.size() )
+    {
+        partial_sort ( sorting.begin(), sorting.begin() + limit, sorting.end(),
+                       byWord );
+        sorting.resize ( limit );
+    }
+    else
+    {
+        sort ( sorting.begin(), sorting.end(), byWord );
+    }
+
+    sorted.clear();
+
+    for ( const sortKey &key : sorting )
+    {
+        sorted.push_back ( key.index );
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes a bucket's count followed by its words in
+ * alphabetical order. When the words are written in parts, a part that
+ * starts after the first word leaves the count to the part before it.
+ *
+ * @param[in]     group - the bucket
+ * @param[in]     first - words an earlier part writes
+ * @param[in]     limit - number of words to write after them
+ * @param[out]    sorting - scratch space for the keys
+ * @param[out]    sorted - scratch space for the entries
+ * @param[in,out] writer - where the bucket is written
+ *
+ ******************************************************************************/
+void WordCounter::writeBucket ( uint32_t group, size_t first, size_t limit,
+                                vector<sortKey> &sorting,
+                                vector<uint32_t> &sorted, ReportWriter &writer )
+{
+    gatherBucket ( group, first, limit, sorting, sorted );
+    writer.frequency ( table.bucketCount ( group ), first );
+
+    for ( uint32_t index : sorted )
+    {
+        writer.word ( table.word ( index ) );
+    }
+}
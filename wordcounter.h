@@ -0,0 +1,283 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Definition of WordCounter class
+*
+******************************************************************************/
+
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+
+#include "wordtable.h"
+#include "stopwords.h"
+#include "report.h"
+
+using namespace std;
+
+#ifndef __WORDCOUNTER_H
+#define __WORDCOUNTER_H
+
+/*!
+ * @brief A word and the number of times it occurred
+ */
+struct wordCount
+{
+    string_view word;   /*!< The prepared word */
+    uint64_t count;     /*!< Number of times the word occurs */
+};
+
+
+
+/*!
+ * @brief counts the words in text handed to it in memory and answers
+ * queries on the counts; the library form of the program
+ */
+class WordCounter
+{
+    public:
+        WordCounter();
+
+        void setStopWords ( StopWords *stop );
+
+        void ingest ( span<const char> text );
+        void ingestBatch ( span<const span<const char>> texts );
+        bool ingest ( istream &in );
+        void merge ( WordCounter &other, uint64_t times = 1 );
+        void setWindow ( size_t epochs );
+        void advanceEpoch();
+        void setMemoryLimit ( size_t bytes );
+        void setVariants ( bool track );
+
+        uint64_t count ( string_view word );
+        size_t topK ( size_t k, span<wordCount> out );
+        template <class Visit> void forEachByFrequency ( Visit visit,
+                bool alphabetical = true );
+        template <class Visit> void forEachWithCount ( uint64_t count,
+                Visit visit, bool alphabetical = true );
+        void report ( ostream &out, reportFormat format = COLUMNS_FORMAT );
+        bool report ( int fd, reportFormat format, unsigned threads );
+        void reportVariants ( ostream &out );
+
+        size_t distinctWords();
+        uint64_t totalWords();
+        uint64_t errorBound();
+        uint64_t prunedWords();
+        size_t memoryUsed();
+        void clear();
+
+        size_t imageSize();
+        void saveImage ( char *image );
+        bool loadImage ( const char *image, size_t size );
+
+    private:
+        void addToken ( const char *word, size_t length );
+        uint32_t addWord ( const char *word, size_t length, uint64_t amount );
+        void prune();
+        uint64_t pruneTo ( uint64_t limit );
+        void record ( uint32_t index, uint64_t amount );
+        bool prepare ( const char *word, size_t length, string_view &prepared,
+                       uint64_t *upper = nullptr );
+        /*!
+        * @brief Used to sort a bucket's entries without reading every word
+        * for every comparison
+        */
+        struct sortKey
+        {
+            uint64_t prefix;    /*!< First 8 characters, big endian */
+            uint32_t index;     /*!< The entry */
+        };
+
+        void gatherBucket ( uint32_t group, size_t first, size_t limit,
+                            vector<sortKey> &sorting, vector<uint32_t> &sorted );
+        void writeBucket ( uint32_t group, size_t first, size_t limit,
+                           vector<sortKey> &sorting, vector<uint32_t> &sorted,
+                           ReportWriter &writer );
+
+        /*!
+        * @brief How much one word was counted in one epoch
+        */
+        struct epochCount
+        {
+            uint32_t index;     /*!< The word's entry */
+            uint64_t count;     /*!< Times counted in the epoch */
+        };
+
+        /*!
+        * @brief Where a word was last counted, so counting it again in the
+        * same epoch adds to the same epochCount
+        */
+        struct recentCount
+        {
+            uint64_t epoch;     /*!< Epoch it was last counted in */
+            uint32_t pair;      /*!< Its epochCount in that epoch */
+        };
+
+        /*!
+        * @brief The first variant of a word, and where its others are
+        */
+        struct variantHead
+        {
+            uint64_t upper;     /*!< Upper case letters, a bit each */
+            uint32_t more;      /*!< First other variant, NONE if none */
+        };
+
+        /*!
+        * @brief A variant of a word other than its first, and its count
+        */
+        struct variantCount
+        {
+            uint64_t upper;     /*!< Upper case letters, a bit each */
+            uint64_t count;     /*!< Times the word was seen this way */
+            uint32_t next;      /*!< The word's next variant, NONE if last */
+        };
+
+        void addVariant ( uint32_t index, uint64_t upper, uint64_t amount,
+                          bool fresh );
+        void mergeVariants ( uint32_t index, bool fresh, WordCounter &other,
+                             uint32_t from, uint64_t times );
+        void gatherVariants ( uint32_t index, vector<variantCount> &list );
+
+        WordTable table;        /*!< The words and their counts */
+        StopWords *stop;        /*!< Words to leave out, may be nullptr */
+        uint64_t total;         /*!< Number of words counted */
+        string scratch;         /*!< Where a word is prepared */
+        vector<char> chunk;     /*!< Block read from a stream */
+        vector<sortKey> keys;   /*!< Entries of a bucket, being sorted */
+        vector<uint32_t> members; /*!< Entries of a bucket, by word */
+        size_t window;          /*!< Epochs counted, 0 to keep every count */
+        uint64_t epoch;         /*!< Number of the current epoch */
+        vector<vector<epochCount>> epochs; /*!< Ring of each epoch's counts */
+        vector<uint64_t> epochWords; /*!< Ring of each epoch's word total */
+        vector<recentCount> recent; /*!< For each entry, where it was last
+                                     counted */
+        size_t memoryLimit;     /*!< Memory the counts may take, 0 for any */
+        uint64_t bound;         /*!< Largest count plus loss pruned so far */
+        uint64_t carried;       /*!< Error bound of counts merged in */
+        uint64_t pruned;        /*!< Words pruned so far */
+        vector<uint64_t> undercount; /*!< For each entry, what its word may
+                                      have lost to pruning */
+        bool variants;          /*!< If the variants of words are counted */
+        vector<variantHead> heads; /*!< For each entry, its first variant */
+        vector<variantCount> cases; /*!< Other variants, chained by word */
+        vector<variantCount> found; /*!< Variants of a word, being sorted */
+};
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function visits every word from most to least frequent, words with
+ * the same frequency in alphabetical order. If visit returns a bool,
+ * visiting stops early when it returns false. The table's buckets are walked
+ * from the highest count down and only the bucket being visited is sorted,
+ * or none when alphabetical is false and the words of a bucket may come in
+ * any order. The sorting space is local, so visit may query the counter,
+ * but it must not change the counts.
+ *
+ * @param[in] visit - called as visit ( string_view word, uint64_t count )
+ * @param[in] alphabetical - if the words of a bucket are sorted
+ *
+ ******************************************************************************/
+template <class Visit> void WordCounter::forEachByFrequency ( Visit visit,
+        bool alphabetical )
+{
+    uint32_t group = table.highestBucket();
+    uint64_t count;
+    vector<sortKey> sorting;
+    vector<uint32_t> sorted;
+
+    while ( group != WordTable::NONE )
+    {
+        count = table.bucketCount ( group );
+
+        if ( alphabetical )
+        {
+            gatherBucket ( group, 0, table.bucketSize ( group ), sorting,
+                           sorted );
+        }
+        else
+        {
+            sorted.clear();
+
+            for ( uint32_t index = table.firstInBucket ( group );
+                    index != WordTable::NONE;
+                    index = table.nextInBucket ( index ) )
+            {
+                sorted.push_back ( index );
+            }
+        }
+
+        for ( uint32_t index : sorted )
+        {
+            if constexpr ( is_void_v<invoke_result_t<Visit, string_view, uint64_t>> )
+            {
+                visit ( table.word ( index ), count );
+            }
+            else if ( !visit ( table.word ( index ), count ) )
+            {
+                return;
+            }
+        }
+
+        group = table.lowerBucket ( group );
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function visits every word that occurred exactly count times, in
+ * alphabetical order unless alphabetical is false. The words come straight
+ * from the bucket for that count, so only the matching words are touched.
+ * The sorting space is local, so visit may query the counter, but it must
+ * not change the counts.
+ *
+ * @param[in] count - the frequency wanted
+ * @param[in] visit - called as visit ( string_view word )
+ * @param[in] alphabetical - if the words are sorted
+ *
+ ******************************************************************************/
+template <class Visit> void WordCounter::forEachWithCount ( uint64_t count,
+        Visit visit, bool alphabetical )
+{
+    uint32_t group = table.bucketWithCount ( count );
+    vector<sortKey> sorting;
+    vector<uint32_t> sorted;
+
+    if ( group == WordTable::NONE )
+    {
+        return;
+    }
+
+    if ( !alphabetical )
+    {
+        for ( uint32_t index = table.firstInBucket ( group );
+                index != WordTable::NONE; index = table.nextInBucket ( index ) )
+        {
+            visit ( table.word ( index ) );
+        }
+
+        return;
+    }
+
+    gatherBucket ( group, 0, table.bucketSize ( group ), sorting, sorted );
+
+    for ( uint32_t index : sorted )
+    {
+        visit ( table.word ( index ) );
+    }
+}
+
+#endif
@@ -0,0 +1,1137 @@
+/**************************************************************************//**
+ * @file
+ * @brief Entry point for the word frequency server
+ *
+ * @details
+ * The server keeps a WordCounter resident and answers queries on it over a
+ * Unix domain socket, so the corpus is counted once instead of on every run.
+ * Any files named on the command line are counted before the socket opens.
+ * All clients are served by one thread from an epoll loop; requests are
+ * answered straight from the counter without copying the table. A client is
+ * read a bounded amount at a time, and the text of an INGEST is counted in
+ * pieces as it arrives, so a large INGEST neither piles up in memory nor
+ * holds up the other clients while it is counted. A TOP or FREQ reply of
+ * more than PIECE_LINES words is the exception: its words are copied out of
+ * the counter once, unsorted, and written a piece at a time, the next word
+ * taken from a heap, so it does not hold up the others either. Once
+ * MAX_OUTPUT bytes of replies wait to be sent to a client, it is neither
+ * read nor answered until they drain.
+ *
+ * With --window the counts cover only the text ingested in the last
+ * SECONDS seconds. The window is split into epochs (60 unless --epochs says
+ * otherwise); each time an epoch ends, the words ingested in the oldest one
+ * are subtracted again, so the counts move in steps of one epoch. Corpus
+ * files count as ingested when the server starts.
+ *
+ * Requests are lines of text, and so are the replies:
+ @verbatim
+ COUNT word      ->  count                (0 if never seen)
+ TOP k           ->  n, then n lines of "count word"
+ FREQ f          ->  n, then n lines of "word" that occurred f times
+                     (both reply "ERR busy" while too many large
+                     replies are being written already)
+ INGEST bytes    ->  followed by that many bytes of text; replies
+                     "OK total" once they are counted, or
+                     "ERR busy" and hangs up if too much text is
+                     waiting to be counted already
+ STATS           ->  "distinct total"
+ anything else   ->  "ERR message"
+ @endverbatim
+ *
+ * @par Usage:
+ @verbatim
+ wordfreqd [--stopwords[=list.txt]] [--window=SECONDS [--epochs=N]]
+           socket [corpus.txt ...]
+ socket - path of the Unix domain socket to listen on
+ corpus.txt - files to count before serving, may be gzip or zstd
+ @endverbatim
+ *
+ *****************************************************************************/
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "wordcounter.h"
+#include "inputfile.h"
+#include "stopwords.h"
+#include "tokenizer.h"
+
+using namespace std;
+
+
+
+/*!
+ * @brief Used to store a word of a reply being written in pieces
+ */
+struct replyWord
+{
+    uint64_t count;     /*!< Times the word occurred */
+    size_t at;          /*!< Where the word starts in the client's copy */
+    size_t length;      /*!< Length of the word */
+};
+
+
+
+/*!
+ * @brief Used to store the state of one client
+ */
+struct client
+{
+    int fd;             /*!< The client's socket */
+    string in;          /*!< Bytes received, not yet answered */
+    uint64_t owed;      /*!< Bytes of INGEST text still to be counted */
+    string out;         /*!< Replies not yet sent */
+    size_t outPos;      /*!< First unsent byte of out */
+    uint32_t watched;   /*!< Events epoll is watching for */
+    vector<char> words; /*!< Copy of the words of a reply in pieces */
+    vector<replyWord> heap; /*!< Those words, next to write on top */
+    size_t holding;     /*!< Bytes those two take */
+    uint64_t left;      /*!< Lines of that reply still to write */
+    bool counts;        /*!< If its lines start with the count */
+};
+
+
+
+/*!
+ * @brief Largest text a single INGEST request may carry
+ */
+static const uint64_t MAX_INGEST = 1ull << 30;
+
+/*!
+ * @brief Most bytes read from one client before the others get a turn
+ */
+static const size_t READ_LIMIT = 1 << 16;
+
+/*!
+ * @brief Longest request line, and longest word of INGEST text that is kept
+ * whole when it arrives in pieces
+ */
+static const size_t MAX_LINE = 1 << 16;
+
+/*!
+ * @brief Bytes received from all clients and not yet answered past which new
+ * INGEST requests are refused
+ */
+static const size_t MAX_BUFFERED = 1 << 26;
+
+/*!
+ * @brief Unsent reply bytes for one client past which it is not read or
+ * answered until they drain
+ */
+static const size_t MAX_OUTPUT = 1 << 20;
+
+/*!
+ * @brief Most lines of a reply written in one piece; a longer TOP or FREQ
+ * reply is copied and written in pieces
+ */
+static const size_t PIECE_LINES = 1024;
+
+/*!
+ * @brief Bytes of the copies of all replies being written in pieces past
+ * which new TOP and FREQ requests are refused
+ */
+static const size_t MAX_HELD = 1 << 30;
+
+/*!
+ * @brief Cleared by SIGINT or SIGTERM to stop serving
+ */
+static volatile sig_atomic_t running = 1;
+
+
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+void stopServing ( int signal );
+int openSocket ( const char *path );
+void acceptClients ( int listener, int epoll,
+                     unordered_map<int, client> &clients );
+bool readClient ( client &c, size_t &buffered );
+bool answerRequests ( client &c, WordCounter &counter, size_t &buffered,
+                      size_t &held );
+bool ingestText ( client &c, size_t &pos, WordCounter &counter );
+void answerTop ( client &c, WordCounter &counter, uint64_t k, size_t &held );
+void answerFreq ( client &c, WordCounter &counter, uint64_t f,
+                  size_t &held );
+void holdWord ( client &c, string_view word, uint64_t count );
+void startPieces ( client &c, uint64_t lines, size_t &held );
+void writePiece ( client &c, size_t &held );
+bool writtenAfter ( const char *words, const replyWord &l,
+                    const replyWord &r );
+bool flushClient ( client &c, int epoll );
+void appendNumber ( string &out, uint64_t value );
+bool parseNumber ( string_view text, uint64_t &value );
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This is the starting point for the server. The arguments are checked, the
+ * stop words are loaded and the corpus files are counted. The socket is then
+ * opened and clients are served until the server is interrupted, when the
+ * socket file is removed.
+ *
+ * @param[in] argc - count of arguments in argv
+ * @param[in] argv - array of arguments read from the command line
+ *
+ * @return 0 - server stopped normally
+ * @return 1 - invalid arguments present
+ * @return 2 - a corpus file, stop word list or the socket failed to open
+ *****************************************************************************/
+int main ( int argc, char **argv )
+{
+    WordCounter counter;            //The resident counts
+    StopWords stop;                 //Words left out of the counts
+    unordered_map<int, client> clients; //Connected clients by socket
+    epoll_event events[64];         //Events from one wait
+    const char *path = nullptr;     //Socket path
+    int listener;                   //Listening socket
+    int epoll;                      //The event loop
+    int ready;                      //Number of events waiting
+    int first = 1;                  //First non option argument
+    string arg;                     //Argument being looked at
+    size_t buffered = 0;            //Bytes received from all clients
+    size_t held = 0;                //Bytes of replies copied for pieces
+    uint64_t window = 0;            //Seconds counted, 0 for all time
+    uint64_t epochs = 60;           //Epochs the window is split into
+    chrono::nanoseconds epochLength {}; //Time one epoch lasts
+    chrono::steady_clock::time_point epochEnd; //When this epoch ends
+
+
+
+    //Options come first
+    for ( ; first < argc && strncmp ( argv[first], "--", 2 ) == 0; first++ )
+    {
+        arg = argv[first];
+
+        if ( arg == "--stopwords" )
+        {
+            stop.useBuiltIn();
+        }
+        else if ( arg.compare ( 0, 12, "--stopwords=" ) == 0 &&
+                  arg.length() > 12 )
+        {
+            if ( !stop.load ( arg.c_str() + 12 ) )
+            {
+                cout << "Error, stop word list did not load!" << endl;
+                return 2;
+            }
+        }
+        else if ( arg.compare ( 0, 9, "--window=" ) == 0 )
+        {
+            if ( !parseNumber ( string_view ( arg ).substr ( 9 ), window ) ||
+                    window == 0 || window > 1000000000 )
+            {
+                first = argc;
+            }
+        }
+        else if ( arg.compare ( 0, 9, "--epochs=" ) == 0 )
+        {
+            if ( !parseNumber ( string_view ( arg ).substr ( 9 ), epochs ) ||
+                    epochs == 0 || epochs > 1000000 )
+            {
+                first = argc;
+            }
+        }
+        else
+        {
+            first = argc;
+        }
+    }
+
+    if ( first >= argc )
+    {
+        cout << "Error, invalid arguments!" << endl;
+        cout << "Usage: " << argv[0]
+             << " [--stopwords[=list.txt]] [--window=SECONDS [--epochs=N]]"
+             << " socket [corpus.txt ...]" << endl;
+        return 1;
+    }
+
+    path = argv[first];
+    counter.setStopWords ( &stop );
+
+    //Epochs shorter than a millisecond are not worth the sweep; the length
+    //is kept in nanoseconds so the epochs add up to the whole window
+    if ( window != 0 )
+    {
+        epochs = min ( epochs, window * 1000 );
+        epochLength = chrono::nanoseconds ( window * 1000000000 / epochs );
+        counter.setWindow ( epochs );
+    }
+
+
+
+    //Count the corpus before taking requests
+    for ( int i = first + 1; i < argc; i++ )
+    {
+        InputFile fin;
+
+        fin.open ( argv[i] );
+
+        if ( !fin || !counter.ingest ( fin ) )
+        {
+            cout << "Error, " << argv[i] << " could not be read!" << endl;
+            return 2;
+        }
+    }
+
+
+
+    listener = openSocket ( path );
+    epoll = epoll_create1 ( 0 );
+
+    if ( listener < 0 || epoll < 0 )
+    {
+        cout << "Error, socket " << path << " did not open!" << endl;
+        return 2;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = listener;
+    epoll_ctl ( epoll, EPOLL_CTL_ADD, listener, &ev );
+
+    signal ( SIGINT, stopServing );
+    signal ( SIGTERM, stopServing );
+    signal ( SIGPIPE, SIG_IGN );
+
+    cout << "Serving " << counter.distinctWords() << " words on " << path
+         << endl;
+
+    epochEnd = chrono::steady_clock::now() + epochLength;
+
+
+
+    while ( running )
+    {
+        int timeout = -1;           //Milliseconds to wait for events
+
+        //Write the next piece of every reply being written in pieces, and
+        //do not wait for events while one can go on
+        if ( held != 0 )
+        {
+            for ( auto it = clients.begin(); it != clients.end(); )
+            {
+                client &c = it->second;
+
+                if ( c.left != 0 && c.out.size() - c.outPos < MAX_OUTPUT &&
+                        ( !answerRequests ( c, counter, buffered, held ) ||
+                          !flushClient ( c, epoll ) ) )
+                {
+                    held -= c.holding;
+                    buffered -= c.in.size();
+                    close ( it->first );
+                    it = clients.erase ( it );
+                    continue;
+                }
+
+                if ( c.left != 0 && c.out.size() - c.outPos < MAX_OUTPUT )
+                {
+                    timeout = 0;
+                }
+
+                ++it;
+            }
+        }
+
+        if ( window != 0 )
+        {
+            auto now = chrono::steady_clock::now();
+            uint64_t passed = 0;
+
+            //Expire every epoch that ended, but sweep a full window at most
+            while ( now >= epochEnd )
+            {
+                if ( passed++ < epochs )
+                {
+                    counter.advanceEpoch();
+                }
+
+                epochEnd += epochLength;
+            }
+
+            if ( timeout != 0 )
+            {
+                timeout = int ( chrono::ceil<chrono::milliseconds> (
+                                    epochEnd - now ).count() );
+            }
+        }
+
+        ready = epoll_wait ( epoll, events, 64, timeout );
+
+        for ( int i = 0; i < ready; i++ )
+        {
+            int fd = events[i].data.fd;
+
+            if ( fd == listener )
+            {
+                acceptClients ( listener, epoll, clients );
+                continue;
+            }
+
+            client &c = clients[fd];
+            bool keep = true;
+
+            if ( events[i].events & EPOLLIN )
+            {
+                keep = readClient ( c, buffered );
+            }
+
+            //Answer what arrived, even if the client then hung up, and what
+            //waited for the replies before it to drain
+            if ( !answerRequests ( c, counter, buffered, held ) )
+            {
+                keep = false;
+            }
+
+            //A hang up is only final once everything sent has been read
+            if ( !flushClient ( c, epoll ) || ( events[i].events & EPOLLERR ) ||
+                    ( events[i].events & ( EPOLLIN | EPOLLHUP ) ) == EPOLLHUP )
+            {
+                keep = false;
+            }
+
+            //Hung up or misbehaved
+            if ( !keep )
+            {
+                held -= c.holding;
+                buffered -= c.in.size();
+                close ( fd );
+                clients.erase ( fd );
+            }
+        }
+    }
+
+
+
+    for ( auto &c : clients )
+    {
+        close ( c.first );
+    }
+
+    close ( epoll );
+    close ( listener );
+    unlink ( path );
+
+    return 0;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function is the signal handler that stops the server.
+ *
+ * @param[in] signal - the signal received
+ *
+ *****************************************************************************/
+void stopServing ( int signal )
+{
+    ( void ) signal;
+    running = 0;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates the listening socket. A socket file left behind by
+ * an earlier run is removed first.
+ *
+ * @param[in] path - where the socket is created
+ *
+ * @returns the listening socket, or -1 if it could not be created
+ *
+ *****************************************************************************/
+int openSocket ( const char *path )
+{
+    sockaddr_un addr = {};
+    int fd;
+
+    if ( strlen ( path ) >= sizeof ( addr.sun_path ) )
+    {
+        return -1;
+    }
+
+    fd = socket ( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0 );
+
+    if ( fd < 0 )
+    {
+        return -1;
+    }
+
+    addr.sun_family = AF_UNIX;
+    strcpy ( addr.sun_path, path );
+    unlink ( path );
+
+    if ( bind ( fd, ( sockaddr * ) &addr, sizeof ( addr ) ) < 0 ||
+            listen ( fd, 128 ) < 0 )
+    {
+        close ( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function accepts every client waiting on the listening socket and
+ * adds it to the event loop.
+ *
+ * @param[in]     listener - the listening socket
+ * @param[in]     epoll - the event loop
+ * @param[in,out] clients - connected clients by socket
+ *
+ *****************************************************************************/
+void acceptClients ( int listener, int epoll,
+                     unordered_map<int, client> &clients )
+{
+    int fd;
+
+    while ( ( fd = accept4 ( listener, nullptr, nullptr, SOCK_NONBLOCK ) ) >= 0 )
+    {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+
+        if ( epoll_ctl ( epoll, EPOLL_CTL_ADD, fd, &ev ) < 0 )
+        {
+            close ( fd );
+            continue;
+        }
+
+        client &c = clients[fd];
+        c.fd = fd;
+        c.in.clear();
+        c.owed = 0;
+        c.out.clear();
+        c.outPos = 0;
+        c.watched = EPOLLIN;
+        c.words.clear();
+        c.heap.clear();
+        c.holding = 0;
+        c.left = 0;
+        c.counts = false;
+    }
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads what the client has sent so far, up to READ_LIMIT
+ * bytes; anything more is read the next time around the event loop.
+ *
+ * @param[in,out] c - the client
+ * @param[in,out] buffered - bytes received from all clients
+ *
+ * @returns true - the client is still connected
+ * @returns false - the client hung up or the read failed
+ *
+ *****************************************************************************/
+bool readClient ( client &c, size_t &buffered )
+{
+    char buffer[65536];
+    size_t total = 0;
+    ssize_t got;
+
+    while ( total < READ_LIMIT )
+    {
+        got = read ( c.fd, buffer, sizeof ( buffer ) );
+
+        if ( got > 0 )
+        {
+            c.in.append ( buffer, ( size_t ) got );
+            total += ( size_t ) got;
+            buffered += ( size_t ) got;
+        }
+        else if ( got == 0 )
+        {
+            return false;
+        }
+        else if ( errno == EAGAIN || errno == EWOULDBLOCK )
+        {
+            return true;
+        }
+        else if ( errno != EINTR )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function answers every complete request the client has sent. The
+ * text of an INGEST is counted as far as it has arrived; it is answered once
+ * all of it has been counted, and the requests after it wait until then.
+ * They also wait for the next piece of a reply being written in pieces, and
+ * for the client's unsent replies to drain below MAX_OUTPUT.
+ *
+ * @param[in,out] c - the client
+ * @param[in,out] counter - the resident counts
+ * @param[in,out] buffered - bytes received from all clients
+ * @param[in,out] held - bytes of replies copied to be written in pieces
+ *
+ * @returns true - the requests were answered
+ * @returns false - the client sent a request line that is too long, an
+ *                  INGEST too large to accept, or an INGEST while too much
+ *                  text is waiting already
+ *
+ *****************************************************************************/
+bool answerRequests ( client &c, WordCounter &counter, size_t &buffered,
+                      size_t &held )
+{
+    size_t pos = 0;         //Start of the next request
+    size_t newline;         //End of its request line
+    string_view line;       //The request line
+    string_view command;    //First word of the line
+    string_view argument;   //Rest of the line
+    uint64_t value = 0;     //Numeric argument
+    size_t space;
+
+    while ( true )
+    {
+        //A reply being written in pieces goes on a piece at a time
+        if ( c.left != 0 )
+        {
+            writePiece ( c, held );
+
+            if ( c.left != 0 )
+            {
+                break;
+            }
+        }
+
+        if ( c.out.size() - c.outPos >= MAX_OUTPUT )
+        {
+            break;
+        }
+
+        //Count what has arrived of the text, stop while more is owed
+        if ( c.owed != 0 && !ingestText ( c, pos, counter ) )
+        {
+            break;
+        }
+
+        newline = c.in.find ( '\n', pos );
+
+        if ( newline == string::npos )
+        {
+            if ( c.in.size() - pos > MAX_LINE )
+            {
+                c.out += "ERR request too long\n";
+                return false;
+            }
+
+            break;
+        }
+
+        line = string_view ( c.in.data() + pos, newline - pos );
+
+        if ( !line.empty() && line.back() == '\r' )
+        {
+            line.remove_suffix ( 1 );
+        }
+
+        space = line.find ( ' ' );
+        command = line.substr ( 0, space );
+        argument = space == string_view::npos ? string_view() :
+                   line.substr ( space + 1 );
+
+        if ( command == "INGEST" )
+        {
+            if ( !parseNumber ( argument, value ) || value > MAX_INGEST )
+            {
+                c.out += "ERR bad INGEST size\n";
+                return false;
+            }
+
+            //The text would follow, and cannot be skipped without reading it
+            if ( buffered >= MAX_BUFFERED )
+            {
+                c.out += "ERR busy\n";
+                return false;
+            }
+
+            pos = newline + 1;
+            c.owed = value;
+
+            //Nothing to count, answer now
+            if ( value == 0 )
+            {
+                ingestText ( c, pos, counter );
+            }
+
+            continue;
+        }
+
+        pos = newline + 1;
+
+        if ( command == "COUNT" )
+        {
+            appendNumber ( c.out, counter.count ( argument ) );
+            c.out += '\n';
+        }
+        else if ( command == "TOP" && parseNumber ( argument, value ) )
+        {
+            answerTop ( c, counter, value, held );
+        }
+        else if ( command == "FREQ" && parseNumber ( argument, value ) )
+        {
+            answerFreq ( c, counter, value, held );
+        }
+        else if ( command == "STATS" )
+        {
+            appendNumber ( c.out, counter.distinctWords() );
+            c.out += ' ';
+            appendNumber ( c.out, counter.totalWords() );
+            c.out += '\n';
+        }
+        else
+        {
+            c.out += "ERR unknown request\n";
+        }
+    }
+
+    c.in.erase ( 0, pos );
+    buffered -= pos;
+
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function counts the part of the client's INGEST text that has
+ * arrived. A word cut off at the end of what arrived is left for the next
+ * read to finish, unless it is longer than MAX_LINE, when it is counted as
+ * it is. Once all of the text has been counted the INGEST is answered.
+ *
+ * @param[in,out] c - the client
+ * @param[in,out] pos - start of the text in the client's input; moved past
+ *                      what was counted
+ * @param[in,out] counter - the resident counts
+ *
+ * @returns true - all of the text has been counted
+ * @returns false - more of the text is still to come
+ *
+ *****************************************************************************/
+bool ingestText ( client &c, size_t &pos, WordCounter &counter )
+{
+    size_t length = ( size_t ) min<uint64_t> ( c.owed, c.in.size() - pos );
+    size_t cut = length;
+
+    //Back up to the white space before a word that is still arriving
+    if ( length < c.owed )
+    {
+        while ( cut > 0 && !isSeparator ( c.in[pos + cut - 1] ) )
+        {
+            cut--;
+        }
+
+        if ( cut == 0 && length > MAX_LINE )
+        {
+            cut = length;
+        }
+    }
+
+    counter.ingest ( span<const char> ( c.in.data() + pos, cut ) );
+    pos += cut;
+    c.owed -= cut;
+
+    if ( c.owed != 0 )
+    {
+        return false;
+    }
+
+    c.out += "OK ";
+    appendNumber ( c.out, counter.totalWords() );
+    c.out += '\n';
+
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function answers a TOP request. A short reply is written at once from
+ * a partial selection of the counts. A longer one copies the words of the
+ * buckets it reaches, unsorted, and is written in pieces; the last bucket
+ * reached may hold more words than are wanted, and those are not written.
+ *
+ * @param[in,out] c - the client
+ * @param[in,out] counter - the resident counts
+ * @param[in]     k - number of words wanted
+ * @param[in,out] held - bytes of replies copied to be written in pieces
+ *
+ *****************************************************************************/
+void answerTop ( client &c, WordCounter &counter, uint64_t k, size_t &held )
+{
+    uint64_t found = min<uint64_t> ( k, counter.distinctWords() );
+    uint64_t taken = 0;
+    uint64_t last = 0;
+
+    if ( found > PIECE_LINES )
+    {
+        if ( held >= MAX_HELD )
+        {
+            c.out += "ERR busy\n";
+            return;
+        }
+
+        counter.forEachByFrequency ( [&] ( string_view word, uint64_t count )
+        {
+            if ( taken >= found && count != last )
+            {
+                return false;
+            }
+
+            holdWord ( c, word, count );
+            last = count;
+            taken++;
+
+            return true;
+        }, false );
+
+        c.counts = true;
+        startPieces ( c, found, held );
+        return;
+    }
+
+    vector<wordCount> top ( ( size_t ) found );
+
+    counter.topK ( ( size_t ) found, top );
+    appendNumber ( c.out, found );
+    c.out += '\n';
+
+    for ( const wordCount &w : top )
+    {
+        appendNumber ( c.out, w.count );
+        c.out += ' ';
+        c.out.append ( w.word.data(), w.word.length() );
+        c.out += '\n';
+    }
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function answers a FREQ request. The words with the count are copied
+ * from its bucket in one unsorted pass, which also tells how many there are,
+ * and are then written in pieces.
+ *
+ * @param[in,out] c - the client
+ * @param[in,out] counter - the resident counts
+ * @param[in]     f - the count wanted
+ * @param[in,out] held - bytes of replies copied to be written in pieces
+ *
+ *****************************************************************************/
+void answerFreq ( client &c, WordCounter &counter, uint64_t f,
+                  size_t &held )
+{
+    if ( held >= MAX_HELD )
+    {
+        c.out += "ERR busy\n";
+        return;
+    }
+
+    counter.forEachWithCount ( f, [&] ( string_view word )
+    {
+        holdWord ( c, word, f );
+    }, false );
+
+    c.counts = false;
+    startPieces ( c, c.heap.size(), held );
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function copies a word of a reply that is written in pieces.
+ *
+ * @param[in,out] c - the client
+ * @param[in]     word - the word
+ * @param[in]     count - times it occurred
+ *
+ *****************************************************************************/
+void holdWord ( client &c, string_view word, uint64_t count )
+{
+    c.heap.push_back ( { count, c.words.size(), word.length() } );
+    c.words.insert ( c.words.end(), word.begin(), word.end() );
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function starts writing the copied words of a reply in pieces. The
+ * number of lines goes out first, and the words are made into a heap with
+ * the most frequent, then alphabetically first, word on top. A reply that
+ * fits in one piece is written at once.
+ *
+ * @param[in,out] c - the client
+ * @param[in]     lines - number of lines in the reply
+ * @param[in,out] held - bytes of replies copied to be written in pieces
+ *
+ *****************************************************************************/
+void startPieces ( client &c, uint64_t lines, size_t &held )
+{
+    const char *words = c.words.data();
+    auto after = [words] ( const replyWord &l, const replyWord &r )
+    {
+        return writtenAfter ( words, l, r );
+    };
+
+    appendNumber ( c.out, lines );
+    c.out += '\n';
+
+    make_heap ( c.heap.begin(), c.heap.end(), after );
+    c.left = lines;
+    c.holding = c.words.capacity() + c.heap.capacity() * sizeof ( replyWord );
+    held += c.holding;
+
+    writePiece ( c, held );
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function writes the next piece of a reply: up to PIECE_LINES lines,
+ * fewer if the client's unsent replies reach MAX_OUTPUT first. Once the
+ * last line is written the copied words are let go.
+ *
+ * @param[in,out] c - the client
+ * @param[in,out] held - bytes of replies copied to be written in pieces
+ *
+ *****************************************************************************/
+void writePiece ( client &c, size_t &held )
+{
+    const char *words = c.words.data();
+    auto after = [words] ( const replyWord &l, const replyWord &r )
+    {
+        return writtenAfter ( words, l, r );
+    };
+
+    for ( size_t lines = 0; c.left != 0 && lines < PIECE_LINES &&
+            c.out.size() - c.outPos < MAX_OUTPUT; lines++ )
+    {
+        pop_heap ( c.heap.begin(), c.heap.end(), after );
+        const replyWord &w = c.heap.back();
+
+        if ( c.counts )
+        {
+            appendNumber ( c.out, w.count );
+            c.out += ' ';
+        }
+
+        c.out.append ( words + w.at, w.length );
+        c.out += '\n';
+        c.heap.pop_back();
+        c.left--;
+    }
+
+    if ( c.left == 0 )
+    {
+        held -= c.holding;
+        c.holding = 0;
+        vector<char>().swap ( c.words );
+        vector<replyWord>().swap ( c.heap );
+    }
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function orders the copied words of a reply for its heap: a word
+ * comes after another if it occurred fewer times, or as many times and is
+ * later alphabetically.
+ *
+ * @param[in] words - the copied words
+ * @param[in] l - the first word
+ * @param[in] r - the second word
+ *
+ * @returns true - l is written after r
+ * @returns false - l is written first, or they are the same word
+ *
+ *****************************************************************************/
+bool writtenAfter ( const char *words, const replyWord &l,
+                    const replyWord &r )
+{
+    if ( l.count != r.count )
+    {
+        return l.count < r.count;
+    }
+
+    return string_view ( words + l.at, l.length ) >
+           string_view ( words + r.at, r.length );
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function sends as much of the pending replies as the socket takes.
+ * If some are left, epoll is asked to report when the socket drains; once
+ * everything is sent it stops watching for that. The client is only watched
+ * for more requests while fewer than MAX_OUTPUT bytes are unsent and no
+ * reply is being written in pieces, so what it sends waits in the socket
+ * instead of in memory.
+ *
+ * @param[in,out] c - the client
+ * @param[in]     epoll - the event loop
+ *
+ * @returns true - the client is still connected
+ * @returns false - the write failed
+ *
+ *****************************************************************************/
+bool flushClient ( client &c, int epoll )
+{
+    ssize_t sent;
+    uint32_t wanted = 0;
+
+    while ( c.outPos < c.out.size() )
+    {
+        sent = write ( c.fd, c.out.data() + c.outPos, c.out.size() - c.outPos );
+
+        if ( sent > 0 )
+        {
+            c.outPos += ( size_t ) sent;
+        }
+        else if ( errno == EAGAIN || errno == EWOULDBLOCK )
+        {
+            break;
+        }
+        else if ( errno != EINTR )
+        {
+            return false;
+        }
+    }
+
+    //All sent, reuse the buffer
+    if ( c.outPos == c.out.size() )
+    {
+        c.out.clear();
+        c.outPos = 0;
+    }
+
+    if ( !c.out.empty() )
+    {
+        wanted |= EPOLLOUT;
+    }
+
+    if ( c.out.size() - c.outPos < MAX_OUTPUT && c.left == 0 )
+    {
+        wanted |= EPOLLIN;
+    }
+
+    if ( wanted != c.watched )
+    {
+        epoll_event ev = {};
+        ev.events = wanted;
+        ev.data.fd = c.fd;
+        epoll_ctl ( epoll, EPOLL_CTL_MOD, c.fd, &ev );
+        c.watched = wanted;
+    }
+
+    return true;
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function appends a number in decimal to a reply.
+ *
+ * @param[in,out] out - the reply
+ * @param[in]     value - the number
+ *
+ *****************************************************************************/
+void appendNumber ( string &out, uint64_t value )
+{
+    char digits[24];
+    char *end = to_chars ( digits, digits + sizeof ( digits ), value ).ptr;
+
+    out.append ( digits, end - digits );
+}
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads a request argument as a decimal number.
+ *
+ * @param[in]  text - the argument
+ * @param[out] value - the number
+ *
+ * @returns true - the argument was a number
+ * @returns false - the argument was empty or not a number
+ *
+ *****************************************************************************/
+bool parseNumber ( string_view text, uint64_t &value )
+{
+    from_chars_result result = from_chars ( text.data(),
+                                            text.data() + text.size(), value );
+
+    return !text.empty() && result.ec == errc() &&
+           result.ptr == text.data() + text.size();
+}
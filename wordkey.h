@@ -0,0 +1,345 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Definition of the fixed width word keys used by the counting tables
+*
+* @details
+* A key is WORD_KEY_SIZE bytes, 16 unless built with -DWORD_KEY_SIZE=32.
+* A word one byte shorter than the key or less is kept inline: its
+* characters, zero padded, with the length in the last byte. Longer words
+* keep their first 8 characters in the key, the offset of the whole word in
+* a side pool in the next 7 bytes, and 0xff in the last byte; the pool holds
+* each long word as an 8 byte length followed by its characters.
+*
+* Two inline keys are equal exactly when all their bytes are, which takes
+* one SSE2 (16 byte) or AVX2 (32 byte) compare. Read as big endian numbers
+* 8 bytes at a time, inline keys also sort in the same order as their words.
+* The functions are defined here so the tables can inline them.
+*
+******************************************************************************/
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#if defined ( __AVX2__ ) || defined ( __SSE2__ )
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+#ifndef __WORDKEY_H
+#define __WORDKEY_H
+
+#ifndef WORD_KEY_SIZE
+#define WORD_KEY_SIZE 16
+#endif
+
+static_assert ( WORD_KEY_SIZE == 16 || WORD_KEY_SIZE == 32,
+                "WORD_KEY_SIZE must be 16 or 32" );
+
+/*!
+ * @brief Longest word kept inside its key
+ */
+inline constexpr size_t INLINE_WORD = WORD_KEY_SIZE - 1;
+
+/*!
+ * @brief Last byte of the key of a word kept in the side pool
+ */
+inline constexpr unsigned char LONG_WORD = 0xff;
+
+
+
+/*!
+ * @brief A word, or a reference to one in a side pool, in a fixed number of
+ * bytes
+ */
+struct wordKey
+{
+    unsigned char bytes[WORD_KEY_SIZE]; /*!< Characters, padding and length */
+};
+
+
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+bool makeKey ( const char *word, size_t length, wordKey &key );
+void spillKey ( const char *word, size_t length, vector<char> &pool,
+                wordKey &key );
+bool isLongKey ( const wordKey &key );
+string_view keyWord ( const wordKey &key, const vector<char> &pool );
+bool sameKey ( const wordKey &l, const wordKey &r );
+uint64_t hashKey ( const wordKey &key );
+bool keyLess ( const wordKey &l, const wordKey &r, const vector<char> &pool );
+uint64_t loadBig ( const unsigned char *bytes );
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function builds the key for a word. A short word is complete in its
+ * key; a long one gets its prefix and the long word mark, and needs
+ * spillKey before its key can be stored or read back.
+ *
+ * @param[in]  word - characters of the word
+ * @param[in]  length - number of characters
+ * @param[out] key - the key
+ *
+ * @returns true - the word fits in the key
+ * @returns false - the word is too long and belongs in a side pool
+ *
+ ******************************************************************************/
+inline bool makeKey ( const char *word, size_t length, wordKey &key )
+{
+    memset ( key.bytes, 0, WORD_KEY_SIZE );
+
+    if ( length <= INLINE_WORD )
+    {
+        memcpy ( key.bytes, word, length );
+        key.bytes[WORD_KEY_SIZE - 1] = ( unsigned char ) length;
+        return true;
+    }
+
+    memcpy ( key.bytes, word, 8 );
+    key.bytes[WORD_KEY_SIZE - 1] = LONG_WORD;
+    return false;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function copies a long word to the end of a side pool and builds a
+ * key that refers to it.
+ *
+ * @param[in]     word - characters of the word
+ * @param[in]     length - number of characters
+ * @param[in,out] pool - the side pool
+ * @param[out]    key - the key
+ *
+ ******************************************************************************/
+inline void spillKey ( const char *word, size_t length, vector<char> &pool,
+                       wordKey &key )
+{
+    uint64_t offset = pool.size();
+    uint64_t size = length;
+
+    makeKey ( word, length, key );
+
+    pool.insert ( pool.end(), ( const char * ) &size,
+                  ( const char * ) &size + 8 );
+    pool.insert ( pool.end(), word, word + length );
+
+    //56 bit offset after the prefix
+    for ( size_t i = 0; i < 7; i++ )
+    {
+        key.bytes[8 + i] = ( unsigned char ) ( offset >> ( 8 * i ) );
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function tells if a key is for a word kept in a side pool.
+ *
+ * @param[in] key - the key
+ *
+ * @returns true - the word is in a side pool
+ * @returns false - the word is inside the key
+ *
+ ******************************************************************************/
+inline bool isLongKey ( const wordKey &key )
+{
+    return key.bytes[WORD_KEY_SIZE - 1] == LONG_WORD;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the word a key stands for. A short word is viewed
+ * inside the key itself, so the key must stay where it is while the view is
+ * used.
+ *
+ * @param[in] key - the key, spilled if long
+ * @param[in] pool - the side pool of long words
+ *
+ * @returns the characters of the word
+ *
+ ******************************************************************************/
+inline string_view keyWord ( const wordKey &key, const vector<char> &pool )
+{
+    uint64_t offset = 0;
+    uint64_t size = 0;
+
+    if ( !isLongKey ( key ) )
+    {
+        return string_view ( ( const char * ) key.bytes,
+                             key.bytes[WORD_KEY_SIZE - 1] );
+    }
+
+    for ( size_t i = 0; i < 7; i++ )
+    {
+        offset |= ( uint64_t ) key.bytes[8 + i] << ( 8 * i );
+    }
+
+    memcpy ( &size, pool.data() + offset, 8 );
+
+    return string_view ( pool.data() + offset + 8, size );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function compares two keys byte for byte with a single vector
+ * compare. For short words that is the same as comparing the words; two
+ * spilled keys are equal only if they refer to the same copy.
+ *
+ * @param[in] l - one key
+ * @param[in] r - the other key
+ *
+ * @returns true - every byte matches
+ * @returns false - the keys differ
+ *
+ ******************************************************************************/
+inline bool sameKey ( const wordKey &l, const wordKey &r )
+{
+#if WORD_KEY_SIZE == 32 && defined ( __AVX2__ )
+    __m256i a = _mm256_loadu_si256 ( ( const __m256i * ) l.bytes );
+    __m256i b = _mm256_loadu_si256 ( ( const __m256i * ) r.bytes );
+
+    return _mm256_movemask_epi8 ( _mm256_cmpeq_epi8 ( a, b ) ) == -1;
+#elif WORD_KEY_SIZE == 16 && defined ( __SSE2__ )
+    __m128i a = _mm_loadu_si128 ( ( const __m128i * ) l.bytes );
+    __m128i b = _mm_loadu_si128 ( ( const __m128i * ) r.bytes );
+
+    return _mm_movemask_epi8 ( _mm_cmpeq_epi8 ( a, b ) ) == 0xffff;
+#else
+    return memcmp ( l.bytes, r.bytes, WORD_KEY_SIZE ) == 0;
+#endif
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function hashes the bytes of a short word's key, 8 at a time with no
+ * branches on the word's length.
+ *
+ * @param[in] key - the key of a short word
+ *
+ * @returns the hash of the word
+ *
+ ******************************************************************************/
+inline uint64_t hashKey ( const wordKey &key )
+{
+    uint64_t hash = 0x9e3779b97f4a7c15ull;
+    uint64_t block;
+
+    for ( size_t i = 0; i < WORD_KEY_SIZE; i += 8 )
+    {
+        memcpy ( &block, key.bytes + i, 8 );
+        hash = ( hash ^ block ) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 29;
+
+    return hash;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function tells if one key's word sorts before another's. Keys are
+ * compared as big endian numbers 8 bytes at a time; only when a long word
+ * shares its first 8 characters with the other word are the words
+ * themselves compared.
+ *
+ * @param[in] l - the left key, spilled if long
+ * @param[in] r - the right key, spilled if long
+ * @param[in] pool - the side pool of long words
+ *
+ * @returns true - the left word comes first
+ * @returns false - the right word comes first or they are the same
+ *
+ ******************************************************************************/
+inline bool keyLess ( const wordKey &l, const wordKey &r,
+                      const vector<char> &pool )
+{
+    uint64_t a = loadBig ( l.bytes );
+    uint64_t b = loadBig ( r.bytes );
+
+    if ( a != b )
+    {
+        return a < b;
+    }
+
+    if ( isLongKey ( l ) || isLongKey ( r ) )
+    {
+        return keyWord ( l, pool ) < keyWord ( r, pool );
+    }
+
+    //The length in the last byte breaks ties between padding and zeros
+    for ( size_t i = 8; i < WORD_KEY_SIZE; i += 8 )
+    {
+        a = loadBig ( l.bytes + i );
+        b = loadBig ( r.bytes + i );
+
+        if ( a != b )
+        {
+            return a < b;
+        }
+    }
+
+    return false;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function reads 8 bytes as a big endian number, so numbers compare
+ * like the bytes do.
+ *
+ * @param[in] bytes - the bytes
+ *
+ * @returns the number
+ *
+ ******************************************************************************/
+inline uint64_t loadBig ( const unsigned char *bytes )
+{
+    uint64_t value = 0;
+
+    for ( size_t i = 0; i < 8; i++ )
+    {
+        value = value << 8 | bytes[i];
+    }
+
+    return value;
+}
+
+#endif
@@ -0,0 +1,1188 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Implementation of WordTable class
+*
+* @details
+* The table is open addressed with linear probing. Each slot holds the index
+* of an entry; the low 32 bits of the hash are kept in the entry so most
+* mismatches are rejected without looking at the word. Words that fit in a
+* key (see wordkey.h) live inside their entry, so a short word is hashed
+* and compared from its key without a branch on its length and without
+* touching other memory; only long words are read from the side pool. The
+* slot array doubles whenever it would become more than half full.
+*
+* Next to the hash index the entries are grouped by count, as in an LFU
+* cache: every count in use has a bucket holding its entries, and the
+* buckets are linked from the lowest count to the highest. Adding to a count
+* moves the entry to the bucket above, which for the usual amount of 1 is
+* either the next bucket or a new one, so the index costs O(1) per word. The
+* highest count, the words with a given count and the words in order of
+* count are then found without looking at the other entries. Buckets for
+* small counts are also found directly through a count to bucket array.
+*
+* Counts can also be taken back, for counting over a sliding window. An
+* entry moves down a bucket the same way it moves up, and one that reaches
+* zero is removed: its slot is closed up by shifting the rest of its probe
+* run back, its index is chained for reuse, and once most of the pool
+* belongs to removed words the live long words are copied to a fresh pool.
+*
+* Every link in the table is an index or an offset, never a pointer, so the
+* arrays can be saved as they are and loaded back into any process: an image
+* is a header and the arrays, each starting on a cache line.
+*
+******************************************************************************/
+#include "wordtable.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+
+/*!
+ * @brief Alignment of each array in an image
+ */
+static const size_t IMAGE_ALIGN = 64;
+
+/*!
+ * @brief Number of slots in a new table
+ */
+static const size_t INITIAL_SLOTS = 1024;
+
+/*!
+ * @brief Counts below this have their bucket kept in the count to bucket
+ * array; larger counts are rare and found by walking down from the highest
+ */
+static const uint64_t DIRECT_COUNTS = 1 << 16;
+
+
+
+/**************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function hashes the characters of a word eight bytes at a time,
+ * scrambling after each block so that similar words land far apart.
+ *
+ * @param[in] word - characters of the word
+ * @param[in] length - number of characters
+ *
+ * @returns the hash of the word
+ *
+ *****************************************************************************/
+uint64_t hashWord ( const char *word, size_t length )
+{
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ length;
+    uint64_t block = 0;
+
+    while ( length >= 8 )
+    {
+        memcpy ( &block, word, 8 );
+        hash = ( hash ^ block ) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+        word += 8;
+        length -= 8;
+    }
+
+    //Last partial block, zero filled
+    block = 0;
+    memcpy ( &block, word, length );
+    hash = ( hash ^ block ) * 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 29;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates an empty table.
+ *
+ ******************************************************************************/
+WordTable::WordTable()
+{
+    slots.assign ( INITIAL_SLOTS, NONE );
+    mask = INITIAL_SLOTS - 1;
+    live = 0;
+    vacant = NONE;
+    garbage = 0;
+    lowest = NONE;
+    highest = NONE;
+    unused = NONE;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function looks up a word.
+ *
+ * @param[in] word - characters of the word
+ * @param[in] length - number of characters in the word
+ *
+ * @returns the index of the word's entry, or NONE if it is not in the table
+ *
+ ******************************************************************************/
+uint32_t WordTable::find ( const char *word, size_t length )
+{
+    wordKey key;
+    uint64_t hash;
+    size_t slot;
+
+    return locate ( word, length, key, hash, slot );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function adds to a word's count, adding the word to the table first if
+ * it is not there yet. The entry then moves to the bucket for its new count.
+ *
+ * @param[in] word - characters of the word
+ * @param[in] length - number of characters in the word
+ * @param[in] amount - how much to add to the count
+ *
+ * @returns the index of the word's entry
+ *
+ ******************************************************************************/
+uint32_t WordTable::add ( const char *word, size_t length, uint64_t amount )
+{
+    wordKey key;
+    uint64_t hash;
+    size_t slot;
+    uint32_t index = locate ( word, length, key, hash, slot );
+    uint32_t group;
+
+    if ( index != NONE )
+    {
+        entry &e = entries[index];
+
+        if ( amount == 0 )
+        {
+            return index;
+        }
+
+        e.count += amount;
+        group = findBucket ( e.count, e.group );
+        leaveBucket ( index );
+        joinBucket ( index, group );
+        return index;
+    }
+
+    //New word, long ones are copied into the pool
+    if ( isLongKey ( key ) )
+    {
+        spillKey ( word, length, pool, key );
+    }
+
+    //Reuse a removed entry first
+    if ( vacant != NONE )
+    {
+        index = vacant;
+        vacant = entries[index].next;
+        entries[index] = { key, amount, ( uint32_t ) hash, NONE, NONE, NONE };
+    }
+    else
+    {
+        index = ( uint32_t ) entries.size();
+        entries.push_back ( { key, amount, ( uint32_t ) hash, NONE, NONE,
+                              NONE
+                            } );
+    }
+
+    slots[slot] = index;
+    joinBucket ( index, findBucket ( amount, NONE ) );
+    live++;
+
+    if ( live * 2 > slots.size() )
+    {
+        grow();
+    }
+
+    return index;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function takes back part of a word's count. The entry moves down to
+ * the bucket for its new count, or is removed if nothing is left.
+ *
+ * @param[in] index - the word's entry
+ * @param[in] amount - how much to take back, at most the word's count
+ *
+ ******************************************************************************/
+void WordTable::subtract ( uint32_t index, uint64_t amount )
+{
+    entry &e = entries[index];
+    uint32_t group;
+
+    if ( amount == 0 )
+    {
+        return;
+    }
+
+    if ( amount >= e.count )
+    {
+        remove ( index );
+        return;
+    }
+
+    e.count -= amount;
+    group = findLowerBucket ( e.count, e.group );
+    leaveBucket ( index );
+    joinBucket ( index, group );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the count stored in an entry.
+ *
+ * @param[in] index - index of the entry
+ *
+ * @returns the number of times the word occurred
+ *
+ ******************************************************************************/
+uint64_t WordTable::count ( uint32_t index )
+{
+    return entries[index].count;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the word stored in an entry. The view stays valid
+ * until another word is added; short words are viewed inside the entry.
+ *
+ * @param[in] index - index of the entry
+ *
+ * @returns the characters of the word
+ *
+ ******************************************************************************/
+string_view WordTable::word ( uint32_t index )
+{
+    return keyWord ( entries[index].key, pool );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the number of distinct words in the table.
+ *
+ * @returns the number of entries holding a word
+ *
+ ******************************************************************************/
+size_t WordTable::size()
+{
+    return live;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the memory the table has reserved for its entries,
+ * slots, buckets and long words, used or not.
+ *
+ * @returns the number of bytes reserved
+ *
+ ******************************************************************************/
+size_t WordTable::memoryUsed()
+{
+    return entries.capacity() * sizeof ( entry ) +
+           slots.capacity() * sizeof ( uint32_t ) + pool.capacity() +
+           buckets.capacity() * sizeof ( bucket ) +
+           byCount.capacity() * sizeof ( uint32_t );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns how much more memory the table could reserve if a
+ * new word were added now: the slots double when they would become more
+ * than half full, the entries grow when none is free for reuse, and the
+ * pool grows when a long word does not fit in it. A new count can also need
+ * a new bucket, counted the same way.
+ *
+ * @param[in] length - number of characters in the word
+ *
+ * @returns the number of bytes the next add could reserve
+ *
+ ******************************************************************************/
+size_t WordTable::memoryToAdd ( size_t length )
+{
+    size_t bytes = 0;
+
+    if ( ( live + 1 ) * 2 > slots.size() )
+    {
+        bytes += slots.size() * 2 * sizeof ( uint32_t );
+    }
+
+    if ( vacant == NONE && entries.size() == entries.capacity() )
+    {
+        bytes += max<size_t> ( entries.capacity(), 1 ) * sizeof ( entry );
+    }
+
+    if ( length > INLINE_WORD && pool.size() + length + 8 > pool.capacity() )
+    {
+        bytes += max ( pool.capacity(), length + 8 );
+    }
+
+    if ( unused == NONE && buckets.size() == buckets.capacity() )
+    {
+        bytes += max<size_t> ( buckets.capacity(), 1 ) * sizeof ( bucket );
+    }
+
+    return bytes;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function removes every word from the table.
+ *
+ ******************************************************************************/
+void WordTable::clear()
+{
+    entries.clear();
+    pool.clear();
+    slots.assign ( INITIAL_SLOTS, NONE );
+    mask = INITIAL_SLOTS - 1;
+    live = 0;
+    vacant = NONE;
+    garbage = 0;
+    buckets.clear();
+    byCount.clear();
+    lowest = NONE;
+    highest = NONE;
+    unused = NONE;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the number of bytes an image of the table takes.
+ *
+ * @returns the size of the image
+ *
+ ******************************************************************************/
+size_t WordTable::imageSize()
+{
+    imageHeader header;
+
+    layImage ( header );
+    return header.size;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function saves the table as an image: a header, then the entries,
+ * slots, pool, buckets and count to bucket array exactly as they are in
+ * memory. Padding between the arrays is zeroed.
+ *
+ * @param[out] image - where the image goes, imageSize bytes
+ *
+ ******************************************************************************/
+void WordTable::saveImage ( char *image )
+{
+    imageHeader header;
+    const void *from[5] = { entries.data(), slots.data(), pool.data(),
+                            buckets.data(), byCount.data()
+                          };
+    size_t item[5] = { sizeof ( entry ), sizeof ( uint32_t ), 1,
+                       sizeof ( bucket ), sizeof ( uint32_t )
+                     };
+
+    layImage ( header );
+    memset ( image, 0, header.size );
+    memcpy ( image, &header, sizeof ( header ) );
+
+    for ( size_t i = 0; i < 5; i++ )
+    {
+        if ( header.length[i] != 0 )
+        {
+            memcpy ( image + header.at[i], from[i], header.length[i] * item[i] );
+        }
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function replaces the table with one saved by saveImage, typically
+ * straight from a mapped file. Each array is copied back whole; nothing is
+ * rehashed or relinked. The image is checked to be laid out the way this
+ * build lays it out and to hold its arrays, not that every link in it is
+ * sound.
+ *
+ * @param[in] image - the image
+ * @param[in] size - number of bytes in the image
+ *
+ * @returns true - the table was loaded
+ * @returns false - the image is too short or laid out differently; the
+ * table is unchanged
+ *
+ ******************************************************************************/
+bool WordTable::loadImage ( const char *image, size_t size )
+{
+    imageHeader header;
+    imageHeader expected;
+    size_t item[5] = { sizeof ( entry ), sizeof ( uint32_t ), 1,
+                       sizeof ( bucket ), sizeof ( uint32_t )
+                     };
+    uint64_t slotCount;
+
+    if ( size < sizeof ( header ) )
+    {
+        return false;
+    }
+
+    memcpy ( &header, image, sizeof ( header ) );
+    layImage ( expected );
+    slotCount = header.length[1];
+
+    if ( header.size > size || header.layout != expected.layout ||
+            slotCount < INITIAL_SLOTS || ( slotCount & ( slotCount - 1 ) ) != 0 ||
+            header.live > header.length[0] )
+    {
+        return false;
+    }
+
+    for ( size_t i = 0; i < 5; i++ )
+    {
+        if ( header.at[i] < sizeof ( header ) || header.at[i] > header.size ||
+                header.length[i] > ( header.size - header.at[i] ) / item[i] )
+        {
+            return false;
+        }
+    }
+
+    const entry *fromEntries = ( const entry * ) ( image + header.at[0] );
+    const uint32_t *fromSlots = ( const uint32_t * ) ( image + header.at[1] );
+    const bucket *fromBuckets = ( const bucket * ) ( image + header.at[3] );
+    const uint32_t *fromByCount = ( const uint32_t * ) ( image + header.at[4] );
+
+    entries.assign ( fromEntries, fromEntries + header.length[0] );
+    slots.assign ( fromSlots, fromSlots + slotCount );
+    pool.assign ( image + header.at[2], image + header.at[2] + header.length[2] );
+    buckets.assign ( fromBuckets, fromBuckets + header.length[3] );
+    byCount.assign ( fromByCount, fromByCount + header.length[4] );
+    mask = slotCount - 1;
+    live = header.live;
+    garbage = header.garbage;
+    vacant = header.vacant;
+    lowest = header.lowest;
+    highest = header.highest;
+    unused = header.unused;
+
+    return true;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the highest count in the table.
+ *
+ * @returns the highest count, 0 if the table is empty
+ *
+ ******************************************************************************/
+uint64_t WordTable::maxCount()
+{
+    if ( highest == NONE )
+    {
+        return 0;
+    }
+
+    return buckets[highest].count;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the bucket with the highest count, where walking the
+ * buckets from most to least frequent starts.
+ *
+ * @returns the bucket, NONE if the table is empty
+ *
+ ******************************************************************************/
+uint32_t WordTable::highestBucket()
+{
+    return highest;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the bucket with the next lower count.
+ *
+ * @param[in] group - the bucket to step down from
+ *
+ * @returns the next bucket down, NONE after the lowest
+ *
+ ******************************************************************************/
+uint32_t WordTable::lowerBucket ( uint32_t group )
+{
+    return buckets[group].lower;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the bucket holding the words with the lowest count.
+ *
+ * @returns the bucket, NONE if the table is empty
+ *
+ ******************************************************************************/
+uint32_t WordTable::lowestBucket()
+{
+    return lowest;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the bucket with the next higher count.
+ *
+ * @param[in] group - a bucket in use
+ *
+ * @returns the next bucket up, NONE if group has the highest count
+ *
+ ******************************************************************************/
+uint32_t WordTable::higherBucket ( uint32_t group )
+{
+    return buckets[group].higher;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function finds the bucket holding the entries with a given count.
+ *
+ * @param[in] count - the count wanted
+ *
+ * @returns the bucket, NONE if no word has that count
+ *
+ ******************************************************************************/
+uint32_t WordTable::bucketWithCount ( uint64_t count )
+{
+    uint32_t group = highest;
+
+    if ( count < DIRECT_COUNTS )
+    {
+        return count < byCount.size() ? byCount[count] : NONE;
+    }
+
+    //Few counts are this large, walk down to it
+    while ( group != NONE && buckets[group].count > count )
+    {
+        group = buckets[group].lower;
+    }
+
+    if ( group == NONE || buckets[group].count != count )
+    {
+        return NONE;
+    }
+
+    return group;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the count shared by the entries in a bucket.
+ *
+ * @param[in] group - the bucket
+ *
+ * @returns the bucket's count
+ *
+ ******************************************************************************/
+uint64_t WordTable::bucketCount ( uint32_t group )
+{
+    return buckets[group].count;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the number of entries in a bucket.
+ *
+ * @param[in] group - the bucket
+ *
+ * @returns the number of words with the bucket's count
+ *
+ ******************************************************************************/
+uint32_t WordTable::bucketSize ( uint32_t group )
+{
+    return buckets[group].size;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the first entry in a bucket. The entries of a bucket
+ * are in no particular order.
+ *
+ * @param[in] group - the bucket
+ *
+ * @returns the index of the first entry
+ *
+ ******************************************************************************/
+uint32_t WordTable::firstInBucket ( uint32_t group )
+{
+    return buckets[group].first;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function returns the entry after the given one in its bucket.
+ *
+ * @param[in] index - index of the entry
+ *
+ * @returns the index of the next entry, NONE after the last
+ *
+ ******************************************************************************/
+uint32_t WordTable::nextInBucket ( uint32_t index )
+{
+    return entries[index].next;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function fills in the header for an image of the table as it is now,
+ * placing each array after the last on a cache line boundary.
+ *
+ * @param[out] header - the header
+ *
+ ******************************************************************************/
+void WordTable::layImage ( imageHeader &header )
+{
+    size_t bytes[5] = { entries.size() * sizeof ( entry ),
+                        slots.size() * sizeof ( uint32_t ), pool.size(),
+                        buckets.size() * sizeof ( bucket ),
+                        byCount.size() * sizeof ( uint32_t )
+                      };
+    uint64_t length[5] = { entries.size(), slots.size(), pool.size(),
+                           buckets.size(), byCount.size()
+                         };
+    uint64_t at = sizeof ( header );
+
+    memset ( &header, 0, sizeof ( header ) );
+    header.layout = sizeof ( entry ) | sizeof ( bucket ) << 16 |
+                    ( uint64_t ) WORD_KEY_SIZE << 32;
+
+    for ( size_t i = 0; i < 5; i++ )
+    {
+        at = ( at + IMAGE_ALIGN - 1 ) & ~( uint64_t ) ( IMAGE_ALIGN - 1 );
+        header.at[i] = at;
+        header.length[i] = length[i];
+        at += bytes[i];
+    }
+
+    header.size = at;
+    header.live = live;
+    header.garbage = garbage;
+    header.vacant = vacant;
+    header.lowest = lowest;
+    header.highest = highest;
+    header.unused = unused;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function doubles the slot array and re-slots every entry using its
+ * stored hash bits. The entries themselves do not move; removed ones are
+ * left out.
+ *
+ ******************************************************************************/
+void WordTable::grow()
+{
+    size_t slot;
+
+    slots.assign ( slots.size() * 2, NONE );
+    mask = slots.size() - 1;
+
+    for ( uint32_t i = 0; i < entries.size(); i++ )
+    {
+        if ( entries[i].group == NONE )
+        {
+            continue;
+        }
+
+        slot = entries[i].hash & mask;
+
+        while ( slots[slot] != NONE )
+        {
+            slot = ( slot + 1 ) & mask;
+        }
+
+        slots[slot] = i;
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function removes a word. Its slot is emptied and the entries after it
+ * in the same probe run are shifted back over the gap, each as far as its
+ * home slot allows, so lookups never need to skip over removed slots. The
+ * entry is chained for reuse and its long word, if any, left as garbage in
+ * the pool.
+ *
+ * @param[in] index - the word's entry
+ *
+ ******************************************************************************/
+void WordTable::remove ( uint32_t index )
+{
+    entry &e = entries[index];
+    size_t slot = e.hash & mask;
+    size_t next;
+    size_t home;
+
+    while ( slots[slot] != index )
+    {
+        slot = ( slot + 1 ) & mask;
+    }
+
+    //Close the gap, moving back any entry whose home is not after it
+    next = slot;
+
+    while ( true )
+    {
+        next = ( next + 1 ) & mask;
+
+        if ( slots[next] == NONE )
+        {
+            break;
+        }
+
+        home = entries[slots[next]].hash & mask;
+
+        if ( ( ( next - home ) & mask ) >= ( ( next - slot ) & mask ) )
+        {
+            slots[slot] = slots[next];
+            slot = next;
+        }
+    }
+
+    slots[slot] = NONE;
+
+    if ( isLongKey ( e.key ) )
+    {
+        garbage += keyWord ( e.key, pool ).length() + 8;
+    }
+
+    leaveBucket ( index );
+    e.count = 0;
+    e.next = vacant;
+    vacant = index;
+    live--;
+
+    if ( garbage > pool.size() / 2 && garbage >= INITIAL_SLOTS * 64 )
+    {
+        compactPool();
+    }
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function copies the long words still in use to a new pool, dropping
+ * those of removed words. It is only called once they are at least half of
+ * the pool, so the copying costs no more than the garbage did to make.
+ *
+ ******************************************************************************/
+void WordTable::compactPool()
+{
+    vector<char> fresh;
+    string_view word;
+
+    fresh.reserve ( pool.size() - garbage );
+
+    for ( entry &e : entries )
+    {
+        if ( e.group != NONE && isLongKey ( e.key ) )
+        {
+            word = keyWord ( e.key, pool );
+            spillKey ( word.data(), word.length(), fresh, e.key );
+        }
+    }
+
+    pool.swap ( fresh );
+    garbage = 0;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function finds the bucket for a count, creating it if no entry has
+ * that count yet. The search walks up from a bucket with a lower count,
+ * usually the one the entry is leaving, so adding 1 looks at one bucket.
+ *
+ * @param[in] count - the count wanted
+ * @param[in] from - a bucket with a lower count, NONE to start at the lowest
+ *
+ * @returns the bucket for the count
+ *
+ ******************************************************************************/
+uint32_t WordTable::findBucket ( uint64_t count, uint32_t from )
+{
+    uint32_t below = from;
+    uint32_t above = from == NONE ? lowest : buckets[from].higher;
+
+    //Small counts are found directly
+    if ( count < byCount.size() && byCount[count] != NONE )
+    {
+        return byCount[count];
+    }
+
+    while ( above != NONE && buckets[above].count < count )
+    {
+        below = above;
+        above = buckets[above].higher;
+    }
+
+    if ( above != NONE && buckets[above].count == count )
+    {
+        return above;
+    }
+
+    return addBucket ( count, below );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function finds the bucket for a count below the given bucket's,
+ * creating it if no entry has that count yet. The search walks down, so
+ * taking 1 back looks at one bucket.
+ *
+ * @param[in] count - the count wanted
+ * @param[in] from - a bucket with a higher count
+ *
+ * @returns the bucket for count
+ *
+ ******************************************************************************/
+uint32_t WordTable::findLowerBucket ( uint64_t count, uint32_t from )
+{
+    uint32_t below = buckets[from].lower;
+
+    //Small counts are found directly
+    if ( count < byCount.size() && byCount[count] != NONE )
+    {
+        return byCount[count];
+    }
+
+    while ( below != NONE && buckets[below].count > count )
+    {
+        below = buckets[below].lower;
+    }
+
+    if ( below != NONE && buckets[below].count == count )
+    {
+        return below;
+    }
+
+    return addBucket ( count, below );
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function creates an empty bucket for a count and links it in right
+ * above the given bucket. Freed buckets are reused before the array grows.
+ *
+ * @param[in] count - count of the new bucket
+ * @param[in] below - bucket to link above, NONE for the bottom
+ *
+ * @returns the new bucket
+ *
+ ******************************************************************************/
+uint32_t WordTable::addBucket ( uint64_t count, uint32_t below )
+{
+    uint32_t group = unused;
+    uint32_t above = below == NONE ? lowest : buckets[below].higher;
+
+    if ( group == NONE )
+    {
+        group = ( uint32_t ) buckets.size();
+        buckets.push_back ( {} );
+    }
+    else
+    {
+        unused = buckets[group].higher;
+    }
+
+    buckets[group] = { count, NONE, 0, below, above };
+
+    //Link the neighbors to the new bucket
+    if ( below == NONE )
+    {
+        lowest = group;
+    }
+    else
+    {
+        buckets[below].higher = group;
+    }
+
+    if ( above == NONE )
+    {
+        highest = group;
+    }
+    else
+    {
+        buckets[above].lower = group;
+    }
+
+    if ( count < DIRECT_COUNTS )
+    {
+        if ( byCount.size() <= count )
+        {
+            byCount.resize ( count + 1, NONE );
+        }
+
+        byCount[count] = group;
+    }
+
+    return group;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function adds an entry to the front of a bucket.
+ *
+ * @param[in] index - index of the entry
+ * @param[in] group - the bucket it joins
+ *
+ ******************************************************************************/
+void WordTable::joinBucket ( uint32_t index, uint32_t group )
+{
+    entry &e = entries[index];
+    bucket &b = buckets[group];
+
+    e.group = group;
+    e.prev = NONE;
+    e.next = b.first;
+
+    if ( b.first != NONE )
+    {
+        entries[b.first].prev = index;
+    }
+
+    b.first = index;
+    b.size++;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function takes an entry out of its bucket. A bucket left empty is
+ * unlinked and put on the free chain.
+ *
+ * @param[in] index - index of the entry
+ *
+ ******************************************************************************/
+void WordTable::leaveBucket ( uint32_t index )
+{
+    entry &e = entries[index];
+    uint32_t group = e.group;
+    bucket &b = buckets[group];
+
+    if ( e.prev == NONE )
+    {
+        b.first = e.next;
+    }
+    else
+    {
+        entries[e.prev].next = e.next;
+    }
+
+    if ( e.next != NONE )
+    {
+        entries[e.next].prev = e.prev;
+    }
+
+    e.group = NONE;
+    b.size--;
+
+    //Still has entries
+    if ( b.size != 0 )
+    {
+        return;
+    }
+
+    if ( b.lower == NONE )
+    {
+        lowest = b.higher;
+    }
+    else
+    {
+        buckets[b.lower].higher = b.higher;
+    }
+
+    if ( b.higher == NONE )
+    {
+        highest = b.lower;
+    }
+    else
+    {
+        buckets[b.higher].lower = b.lower;
+    }
+
+    if ( b.count < byCount.size() )
+    {
+        byCount[b.count] = NONE;
+    }
+
+    b.higher = unused;
+    unused = group;
+}
+
+
+
+/***************************************************************************//**
+ * @author Christian Fattig
+ *
+ * @par Description:
+ * This function builds a word's key and hash and probes for it. A short
+ * word is matched on its hash bits and key alone; a long word's key cannot
+ * be matched until it is spilled, so long words are matched on their
+ * characters in the pool.
+ *
+ * @param[in]  word - characters of the word
+ * @param[in]  length - number of characters in the word
+ * @param[out] key - the word's key, not yet spilled if long
+ * @param[out] hash - the word's hash
+ * @param[out] slot - the word's slot, or the empty slot it belongs in
+ *
+ * @returns the index of the word's entry, or NONE if it is not in the table
+ *
+ ******************************************************************************/
+uint32_t WordTable::locate ( const char *word, size_t length, wordKey &key,
+                             uint64_t &hash, size_t &slot )
+{
+    uint32_t index;
+    bool fits = makeKey ( word, length, key );
+
+    hash = fits ? hashKey ( key ) : hashWord ( word, length );
+    slot = ( uint32_t ) hash & mask;
+
+    //Probe until the word or an empty slot turns up
+    while ( ( index = slots[slot] ) != NONE )
+    {
+        entry &e = entries[index];
+
+        if ( e.hash == ( uint32_t ) hash && ( fits ? sameKey ( e.key, key ) :
+                                              isLongKey ( e.key ) &&
+                                              keyWord ( e.key, pool ) ==
+                                              string_view ( word, length ) ) )
+        {
+            return index;
+        }
+
+        slot = ( slot + 1 ) & mask;
+    }
+
+    return NONE;
+}
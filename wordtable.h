@@ -0,0 +1,138 @@
+/**************************************************************************//**
+*
+* @file
+* @brief Definition of WordTable class
+*
+******************************************************************************/
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "wordkey.h"
+
+using namespace std;
+
+#ifndef __WORDTABLE_H
+#define __WORDTABLE_H
+
+/******************************************************************************
+ *                         Function Prototypes
+ *****************************************************************************/
+uint64_t hashWord ( const char *word, size_t length );
+
+
+
+/*!
+ * @brief hash table of words and their frequency counts. An entry keeps its
+ * index once added, so the index can be held onto; short words are kept
+ * inside the entry's key and long ones in a shared side pool. Entries with
+ * the same count are grouped in a bucket, and the buckets are linked in
+ * order of count. A word whose count is taken back to zero is removed and
+ * its index handed to the next new word.
+ */
+class WordTable
+{
+    public:
+        static constexpr uint32_t NONE = 0xffffffff; /*!< Index of no entry */
+
+        WordTable();
+
+        uint32_t find ( const char *word, size_t length );
+        uint32_t add ( const char *word, size_t length, uint64_t amount );
+        void subtract ( uint32_t index, uint64_t amount );
+        uint64_t count ( uint32_t index );
+        string_view word ( uint32_t index );
+        size_t size();
+        size_t memoryUsed();
+        size_t memoryToAdd ( size_t length );
+        void clear();
+
+        size_t imageSize();
+        void saveImage ( char *image );
+        bool loadImage ( const char *image, size_t size );
+
+        uint64_t maxCount();
+        uint32_t highestBucket();
+        uint32_t lowerBucket ( uint32_t group );
+        uint32_t lowestBucket();
+        uint32_t higherBucket ( uint32_t group );
+        uint32_t bucketWithCount ( uint64_t count );
+        uint64_t bucketCount ( uint32_t group );
+        uint32_t bucketSize ( uint32_t group );
+        uint32_t firstInBucket ( uint32_t group );
+        uint32_t nextInBucket ( uint32_t index );
+
+    private:
+        void grow();
+        uint32_t locate ( const char *word, size_t length, wordKey &key,
+                          uint64_t &hash, size_t &slot );
+        void remove ( uint32_t index );
+        void compactPool();
+        uint32_t findBucket ( uint64_t count, uint32_t from );
+        uint32_t findLowerBucket ( uint64_t count, uint32_t from );
+        uint32_t addBucket ( uint64_t count, uint32_t below );
+        void joinBucket ( uint32_t index, uint32_t group );
+        void leaveBucket ( uint32_t index );
+
+        /*!
+        * @brief Used to store one word and its count
+        */
+        struct entry
+        {
+            wordKey key;        /*!< The word, or where it is in the pool */
+            uint64_t count;     /*!< Number of times the word occurs */
+            uint32_t hash;      /*!< Low bits of the hash of the word */
+            uint32_t group;     /*!< Bucket for the word's count */
+            uint32_t prev;      /*!< Previous entry in the bucket */
+            uint32_t next;      /*!< Next entry in the bucket */
+        };
+
+        /*!
+        * @brief Start of a saved image of the table: how the arrays are laid
+        * out after it, and the table's other members
+        */
+        struct imageHeader
+        {
+            uint64_t size;      /*!< Bytes in the image */
+            uint64_t layout;    /*!< Sizes of an entry, bucket and key */
+            uint64_t at[5];     /*!< Offset of each array in the image */
+            uint64_t length[5]; /*!< Number of items in each array */
+            uint64_t live;      /*!< Entries holding a word */
+            uint64_t garbage;   /*!< Pool bytes of removed words */
+            uint32_t vacant;    /*!< First removed entry */
+            uint32_t lowest;    /*!< Bucket with the lowest count */
+            uint32_t highest;   /*!< Bucket with the highest count */
+            uint32_t unused;    /*!< First free bucket */
+        };
+
+        void layImage ( imageHeader &header );
+
+        /*!
+        * @brief Used to group the entries that have the same count
+        */
+        struct bucket
+        {
+            uint64_t count;     /*!< Count shared by the entries */
+            uint32_t first;     /*!< First entry in the bucket */
+            uint32_t size;      /*!< Number of entries in the bucket */
+            uint32_t lower;     /*!< Bucket with the next lower count */
+            uint32_t higher;    /*!< Bucket with the next higher count */
+        };
+
+        vector<entry> entries;  /*!< Words in the order they were added */
+        vector<uint32_t> slots; /*!< Open addressed index into entries */
+        vector<char> pool;      /*!< Words too long for their key */
+        size_t live;            /*!< Entries holding a word */
+        uint32_t vacant;        /*!< First removed entry, chained by next */
+        size_t garbage;         /*!< Pool bytes of removed words */
+        size_t mask;            /*!< slots.size() - 1 */
+        vector<bucket> buckets; /*!< Buckets, in use or free */
+        vector<uint32_t> byCount; /*!< Bucket for each small count */
+        uint32_t lowest;        /*!< Bucket with the lowest count */
+        uint32_t highest;       /*!< Bucket with the highest count */
+        uint32_t unused;        /*!< First free bucket, chained by higher */
+};
+
+#endif